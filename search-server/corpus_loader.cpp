@@ -0,0 +1,494 @@
+#include "corpus_loader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+struct ParsedRecord {
+    int id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    // Range in ParsedChunk::ratings
+    uint32_t ratings_begin = 0;
+    uint32_t ratings_end = 0;
+    string_view text;
+};
+
+// Buffers of one chunk. They are reused by every chunk passing through the slot,
+// so the steady state of the pipeline does not allocate
+struct ParsedChunk {
+    vector<ParsedRecord> records;
+    vector<SearchServer::TokenizedDocument> tokenized_documents;
+    vector<int> ratings;
+    // Unescaped JSON strings; reserved to the chunk size so that views into it stay valid
+    string unescaped;
+    size_t rejected_records = 0;
+};
+
+const string_view STATUS_NAMES[DOCUMENT_STATUS_COUNT] = {"ACTUAL", "IRRELEVANT", "BANNED", "REMOVED"};
+
+bool ParseStatus(string_view text, DocumentStatus& status) {
+    for (int i = 0; i < DOCUMENT_STATUS_COUNT; ++i) {
+        if (text == STATUS_NAMES[i] || (text.size() == 1 && text[0] == '0' + i)) {
+            status = static_cast<DocumentStatus>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseInt(string_view text, int& value) {
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    return error == errc() && end == text.data() + text.size();
+}
+
+// Integers separated by spaces or commas
+bool ParseRatings(string_view text, vector<int>& ratings) {
+    while (true) {
+        const size_t begin = text.find_first_not_of(" ,");
+        if (begin == string_view::npos) {
+            return true;
+        }
+        text.remove_prefix(begin);
+        const size_t end = min(text.find_first_of(" ,"), text.size());
+        int rating;
+        if (!ParseInt(text.substr(0, end), rating)) {
+            return false;
+        }
+        ratings.push_back(rating);
+        text.remove_prefix(end);
+    }
+}
+
+string_view NextField(string_view& line) {
+    const size_t tab = line.find('\t');
+    const string_view field = line.substr(0, tab);
+    line.remove_prefix(tab == string_view::npos ? line.size() : tab + 1);
+    return field;
+}
+
+bool ParseTsvRecord(string_view line, ParsedChunk& chunk, ParsedRecord& record) {
+    const string_view id = NextField(line);
+    const string_view status = NextField(line);
+    const string_view ratings = NextField(line);
+    record.ratings_begin = static_cast<uint32_t>(chunk.ratings.size());
+    if (!ParseInt(id, record.id) || !ParseStatus(status, record.status)
+        || !ParseRatings(ratings, chunk.ratings)) {
+        return false;
+    }
+    record.ratings_end = static_cast<uint32_t>(chunk.ratings.size());
+    record.text = line;
+    return true;
+}
+
+class JsonLineParser {
+public:
+    JsonLineParser(string_view line, string& unescaped)
+        : line_(line)
+        , unescaped_(unescaped) {
+    }
+
+    bool Consume(char c) {
+        SkipSpaces();
+        if (line_.empty() || line_[0] != c) {
+            return false;
+        }
+        line_.remove_prefix(1);
+        return true;
+    }
+
+    // The view points into the line or, for a string with escapes, into the unescaped buffer
+    bool ParseString(string_view& value) {
+        if (!Consume('"')) {
+            return false;
+        }
+        const size_t end = line_.find_first_of("\"\\");
+        if (end == string_view::npos) {
+            return false;
+        }
+        if (line_[end] == '"') {
+            value = line_.substr(0, end);
+            line_.remove_prefix(end + 1);
+            return true;
+        }
+        const size_t start = unescaped_.size();
+        while (!line_.empty() && line_[0] != '"') {
+            if (line_[0] != '\\') {
+                unescaped_ += line_[0];
+                line_.remove_prefix(1);
+            } else if (!ParseEscape()) {
+                return false;
+            }
+        }
+        if (line_.empty()) {
+            return false;
+        }
+        line_.remove_prefix(1);
+        value = string_view(unescaped_).substr(start);
+        return true;
+    }
+
+    bool ParseNumber(string_view& value) {
+        SkipSpaces();
+        const size_t end = min(line_.find_first_of(" \t,]}"), line_.size());
+        value = line_.substr(0, end);
+        line_.remove_prefix(end);
+        return !value.empty();
+    }
+
+    bool IsAtEnd() {
+        SkipSpaces();
+        return line_.empty();
+    }
+
+private:
+    string_view line_;
+    string& unescaped_;
+
+    void SkipSpaces() {
+        line_.remove_prefix(min(line_.find_first_not_of(" \t\r"), line_.size()));
+    }
+
+    bool ParseHex(uint32_t& code) {
+        if (line_.size() < 4) {
+            return false;
+        }
+        const auto [end, error] = from_chars(line_.data(), line_.data() + 4, code, 16);
+        line_.remove_prefix(4);
+        return error == errc() && end == line_.data();
+    }
+
+    bool ParseEscape() {
+        if (line_.size() < 2) {
+            return false;
+        }
+        const char c = line_[1];
+        line_.remove_prefix(2);
+        switch (c) {
+            case '"': case '\\': case '/': unescaped_ += c; return true;
+            case 'b': unescaped_ += '\b'; return true;
+            case 'f': unescaped_ += '\f'; return true;
+            case 'n': unescaped_ += '\n'; return true;
+            case 'r': unescaped_ += '\r'; return true;
+            case 't': unescaped_ += '\t'; return true;
+            case 'u': break;
+            default: return false;
+        }
+        uint32_t code;
+        if (!ParseHex(code)) {
+            return false;
+        }
+        if (code >= 0xD800 && code < 0xDC00) {
+            uint32_t low;
+            if (line_.substr(0, 2) != "\\u"sv) {
+                return false;
+            }
+            line_.remove_prefix(2);
+            if (!ParseHex(low) || low < 0xDC00 || low >= 0xE000) {
+                return false;
+            }
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        }
+        AppendUtf8(code);
+        return true;
+    }
+
+    void AppendUtf8(uint32_t code) {
+        if (code < 0x80) {
+            unescaped_ += static_cast<char>(code);
+        } else if (code < 0x800) {
+            unescaped_ += static_cast<char>(0xC0 | (code >> 6));
+            unescaped_ += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            unescaped_ += static_cast<char>(0xE0 | (code >> 12));
+            unescaped_ += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            unescaped_ += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            unescaped_ += static_cast<char>(0xF0 | (code >> 18));
+            unescaped_ += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            unescaped_ += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            unescaped_ += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+};
+
+bool ParseJsonRecord(string_view line, ParsedChunk& chunk, ParsedRecord& record) {
+    JsonLineParser parser(line, chunk.unescaped);
+    if (!parser.Consume('{')) {
+        return false;
+    }
+    record.ratings_begin = record.ratings_end = static_cast<uint32_t>(chunk.ratings.size());
+    bool has_id = false;
+    bool has_text = false;
+    bool first = true;
+    while (!parser.Consume('}')) {
+        string_view key;
+        if ((!first && !parser.Consume(',')) || !parser.ParseString(key) || !parser.Consume(':')) {
+            return false;
+        }
+        first = false;
+        string_view value;
+        if (key == "id"sv) {
+            has_id = parser.ParseNumber(value) && ParseInt(value, record.id);
+            if (!has_id) {
+                return false;
+            }
+        } else if (key == "status"sv) {
+            //a name in quotes or a number
+            if ((!parser.ParseString(value) && !parser.ParseNumber(value))
+                || !ParseStatus(value, record.status)) {
+                return false;
+            }
+        } else if (key == "ratings"sv) {
+            if (!parser.Consume('[')) {
+                return false;
+            }
+            for (bool first_rating = true; !parser.Consume(']'); first_rating = false) {
+                int rating;
+                if ((!first_rating && !parser.Consume(',')) || !parser.ParseNumber(value)
+                    || !ParseInt(value, rating)) {
+                    return false;
+                }
+                chunk.ratings.push_back(rating);
+            }
+            record.ratings_end = static_cast<uint32_t>(chunk.ratings.size());
+        } else if (key == "text"sv) {
+            has_text = parser.ParseString(record.text);
+            if (!has_text) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return has_id && has_text && parser.IsAtEnd();
+}
+
+void ParseChunk(const SearchServer& search_server, string_view data, CorpusFormat format,
+                ParsedChunk& chunk) {
+    chunk.records.clear();
+    chunk.ratings.clear();
+    chunk.unescaped.clear();
+    chunk.unescaped.reserve(data.size());
+    chunk.rejected_records = 0;
+
+    while (!data.empty()) {
+        const size_t line_end = min(data.find('\n'), data.size());
+        string_view line = data.substr(0, line_end);
+        data.remove_prefix(min(line_end + 1, data.size()));
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.find_first_not_of(" \t") == string_view::npos) {
+            continue;
+        }
+        ParsedRecord record;
+        const bool is_parsed = format == CorpusFormat::TSV ? ParseTsvRecord(line, chunk, record)
+                                                           : ParseJsonRecord(line, chunk, record);
+        if (is_parsed) {
+            chunk.records.push_back(record);
+        } else {
+            ++chunk.rejected_records;
+        }
+    }
+
+    if (chunk.tokenized_documents.size() < chunk.records.size()) {
+        chunk.tokenized_documents.resize(chunk.records.size());
+    }
+    for (size_t i = 0; i < chunk.records.size(); ++i) {
+        search_server.TokenizeDocument(chunk.records[i].text, chunk.tokenized_documents[i]);
+    }
+}
+
+// Chunk boundaries at line ends; only the bytes around the boundaries are read here
+vector<pair<size_t, size_t>> SplitIntoChunks(string_view data, size_t chunk_size) {
+    vector<pair<size_t, size_t>> chunks;
+    size_t begin = 0;
+    while (begin < data.size()) {
+        size_t end = min(begin + max<size_t>(chunk_size, 1), data.size());
+        if (end < data.size()) {
+            const void* line_end = memchr(data.data() + end, '\n', data.size() - end);
+            end = line_end == nullptr ? data.size()
+                                      : static_cast<const char*>(line_end) - data.data() + 1;
+        }
+        chunks.push_back({begin, end});
+        begin = end;
+    }
+    return chunks;
+}
+
+class MappedFile {
+public:
+    explicit MappedFile(const string& path) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw runtime_error("Не удалось открыть файл "s + path + ": "s + strerror(errno));
+        }
+        struct stat file_stat{};
+        if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+            close(fd);
+            throw runtime_error("Файл "s + path + " не является обычным файлом"s);
+        }
+        size_ = static_cast<size_t>(file_stat.st_size);
+        if (size_ > 0) {
+            void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                close(fd);
+                throw runtime_error("Не удалось отобразить файл "s + path + " в память: "s + strerror(errno));
+            }
+            data_ = static_cast<const char*>(data);
+            madvise(data, size_, MADV_SEQUENTIAL);
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (data_ != nullptr) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    string_view GetData() const {
+        return {data_, size_};
+    }
+
+    // The pages before the offset will not be read again
+    void Release(size_t end) {
+        const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t release_end = end / page_size * page_size;
+        if (release_end > released_) {
+            madvise(const_cast<char*>(data_) + released_, release_end - released_, MADV_DONTNEED);
+            released_ = release_end;
+        }
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t released_ = 0;
+};
+
+}  // namespace
+
+CorpusLoadResult LoadCorpus(SearchServer& search_server, const string& path, CorpusLoadOptions options) {
+    MappedFile file(path);
+    const string_view data = file.GetData();
+    const auto chunks = SplitIntoChunks(data, options.chunk_size);
+
+    int parser_count = options.parser_threads;
+    if (parser_count <= 0) {
+        parser_count = max(1, static_cast<int>(thread::hardware_concurrency()) - 1);
+    }
+    const size_t slot_count = static_cast<size_t>(max(1, options.chunks_in_flight));
+    vector<ParsedChunk> slots(slot_count);
+    //chunk i goes to slot i % slot_count once the chunk i - slot_count has been indexed
+    vector<size_t> parsed_chunk(slot_count, SIZE_MAX);
+    size_t indexed_chunk_count = 0;
+    mutex slots_mutex;
+    condition_variable slot_parsed;
+    condition_variable slot_freed;
+    atomic<size_t> next_chunk = 0;
+    //set when the indexer leaves early because of an exception
+    bool is_cancelled = false;
+
+    auto parse_chunks = [&] {
+        while (true) {
+            const size_t chunk_index = next_chunk++;
+            if (chunk_index >= chunks.size()) {
+                return;
+            }
+            const size_t slot = chunk_index % slot_count;
+            {
+                unique_lock lock(slots_mutex);
+                slot_freed.wait(lock, [&] {
+                    return is_cancelled || chunk_index < indexed_chunk_count + slot_count;
+                });
+                if (is_cancelled) {
+                    return;
+                }
+            }
+            const auto [begin, end] = chunks[chunk_index];
+            ParseChunk(search_server, data.substr(begin, end - begin), options.format, slots[slot]);
+            {
+                lock_guard lock(slots_mutex);
+                parsed_chunk[slot] = chunk_index;
+            }
+            slot_parsed.notify_all();
+        }
+    };
+
+    vector<thread> parsers;
+    for (int i = 0; i < parser_count; ++i) {
+        parsers.emplace_back(parse_chunks);
+    }
+    auto stop_parsers = [&] {
+        {
+            lock_guard lock(slots_mutex);
+            is_cancelled = true;
+        }
+        slot_freed.notify_all();
+        for (thread& parser : parsers) {
+            parser.join();
+        }
+    };
+
+    CorpusLoadResult result;
+    result.bytes = data.size();
+    vector<int> ratings;
+    try {
+        for (size_t chunk_index = 0; chunk_index < chunks.size(); ++chunk_index) {
+            const size_t slot = chunk_index % slot_count;
+            {
+                unique_lock lock(slots_mutex);
+                slot_parsed.wait(lock, [&] {
+                    return parsed_chunk[slot] == chunk_index;
+                });
+            }
+            ParsedChunk& chunk = slots[slot];
+            result.rejected_records += chunk.rejected_records;
+            for (size_t i = 0; i < chunk.records.size(); ++i) {
+                const ParsedRecord& record = chunk.records[i];
+                ratings.assign(chunk.ratings.begin() + record.ratings_begin,
+                               chunk.ratings.begin() + record.ratings_end);
+                try {
+                    search_server.AddDocument(record.id, record.text, chunk.tokenized_documents[i],
+                                              record.status, ratings);
+                    ++result.added_documents;
+                } catch (const invalid_argument&) {
+                    ++result.rejected_records;
+                }
+            }
+            {
+                lock_guard lock(slots_mutex);
+                indexed_chunk_count = chunk_index + 1;
+            }
+            slot_freed.notify_all();
+            //the text is copied into the index, the mapped pages are no longer needed
+            file.Release(chunks[chunk_index].second);
+        }
+    } catch (...) {
+        stop_parsers();
+        throw;
+    }
+    stop_parsers();
+    return result;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "search_server.h"
+
+// Record formats, one document per line:
+//   TSV:   id <TAB> status <TAB> ratings separated by spaces or commas <TAB> text
+//   JSONL: {"id": 1, "status": "ACTUAL", "ratings": [1, 2], "text": "..."}
+// status is a DocumentStatus name (ACTUAL, IRRELEVANT, BANNED, REMOVED) or its number
+enum class CorpusFormat {
+    TSV,
+    JSONL,
+};
+
+struct CorpusLoadOptions {
+    CorpusFormat format = CorpusFormat::TSV;
+    // The file is cut into chunks of about this size at line ends
+    size_t chunk_size = 8 << 20;
+    // Threads parsing and tokenizing chunks; 0 — one less than the number of cores
+    int parser_threads = 0;
+    // Parsed chunks waiting for the index; bounds the memory used by the loader
+    int chunks_in_flight = 8;
+};
+
+struct CorpusLoadResult {
+    size_t added_documents = 0;
+    // Malformed lines and documents rejected by SearchServer::AddDocument
+    size_t rejected_records = 0;
+    uint64_t bytes = 0;
+};
+
+// Memory-maps the file and loads it in a pipeline: parser threads parse and tokenize
+// chunks into reused buffers, the calling thread adds them to the index in file order.
+// Throws std::runtime_error if the file can not be opened or mapped
+CorpusLoadResult LoadCorpus(SearchServer& search_server, const std::string& path,
+                            CorpusLoadOptions options = {});
@@ -0,0 +1,514 @@
+#include "distributed_search.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+enum RequestType : uint8_t {
+    ADD_DOCUMENT = 1,
+    REMOVE_DOCUMENT,
+    QUERY_STATISTICS,
+    FIND_TOP_DOCUMENTS,
+    MATCH_DOCUMENT,
+};
+
+enum ResponseType : uint8_t {
+    RESPONSE_OK = 100,
+    RESPONSE_INVALID_ARGUMENT,
+    RESPONSE_OUT_OF_RANGE,
+    RESPONSE_ERROR,
+};
+
+// Frame: uint32 payload size, uint8 type, payload
+const size_t FRAME_HEADER_SIZE = 5;
+const uint32_t MAX_FRAME_SIZE = 64u << 20;
+
+class PayloadWriter {
+public:
+    template <typename Number>
+    PayloadWriter& Put(Number value) {
+        data_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        return *this;
+    }
+
+    PayloadWriter& PutString(string_view text) {
+        Put(static_cast<uint32_t>(text.size()));
+        data_.append(text);
+        return *this;
+    }
+
+    string& Data() {
+        return data_;
+    }
+
+private:
+    string data_;
+};
+
+class PayloadReader {
+public:
+    explicit PayloadReader(string_view data)
+        : data_(data) {
+    }
+
+    template <typename Number>
+    Number Get() {
+        Number value;
+        memcpy(&value, Take(sizeof(value)).data(), sizeof(value));
+        return value;
+    }
+
+    string_view GetString() {
+        return Take(Get<uint32_t>());
+    }
+
+    // An enumerator sent as uint8; a value from count on would index past the tables
+    // of the server, so the message is rejected
+    template <typename Enum>
+    Enum GetEnum(int count) {
+        const uint8_t value = Get<uint8_t>();
+        if (value >= count) {
+            throw invalid_argument("Недопустимое значение "s + to_string(value)
+                                   + " в сообщении протокола поиска"s);
+        }
+        return static_cast<Enum>(value);
+    }
+
+private:
+    string_view data_;
+
+    string_view Take(size_t size) {
+        if (size > data_.size()) {
+            throw invalid_argument("Повреждённое сообщение протокола поиска"s);
+        }
+        const string_view part = data_.substr(0, size);
+        data_.remove_prefix(size);
+        return part;
+    }
+};
+
+bool SendFrame(int fd, uint8_t type, string_view payload, SocketClock::time_point deadline) {
+    char header[FRAME_HEADER_SIZE];
+    const uint32_t size = static_cast<uint32_t>(payload.size());
+    memcpy(header, &size, sizeof(size));
+    header[4] = static_cast<char>(type);
+    return WriteAll(fd, header, FRAME_HEADER_SIZE, deadline)
+        && WriteAll(fd, payload.data(), payload.size(), deadline);
+}
+
+bool ReceiveFrame(int fd, uint8_t& type, string& payload, SocketClock::time_point deadline) {
+    char header[FRAME_HEADER_SIZE];
+    if (!ReadAll(fd, header, FRAME_HEADER_SIZE, deadline)) {
+        return false;
+    }
+    uint32_t size;
+    memcpy(&size, header, sizeof(size));
+    if (size > MAX_FRAME_SIZE) {
+        return false;
+    }
+    type = static_cast<uint8_t>(header[4]);
+    payload.resize(size);
+    return ReadAll(fd, payload.data(), size, deadline);
+}
+
+void WriteStatistics(PayloadWriter& writer, const CollectionStatistics& statistics) {
+    writer.Put(static_cast<int32_t>(statistics.document_count)).Put(static_cast<int64_t>(statistics.word_count));
+    writer.Put(static_cast<uint32_t>(statistics.word_document_counts.size()));
+    for (const auto& [word, count] : statistics.word_document_counts) {
+        writer.PutString(word).Put(static_cast<int32_t>(count));
+    }
+}
+
+// Everything but the collection, which the coordinator merges from the statistics of the workers
+void WriteSearchOptions(PayloadWriter& writer, const SearchOptions& options) {
+    writer.Put(static_cast<uint8_t>(options.mode)).Put(static_cast<uint8_t>(options.ranking))
+          .Put(options.bm25.k1).Put(options.bm25.b);
+    writer.Put(static_cast<uint32_t>(options.field_weights.size()));
+    for (const auto& [name, weight] : options.field_weights) {
+        writer.PutString(name).Put(weight);
+    }
+    writer.Put(static_cast<uint8_t>(options.use_impact_tier)).Put(options.min_tier_recall);
+}
+
+SearchOptions ReadSearchOptions(PayloadReader& reader) {
+    SearchOptions options;
+    options.mode = reader.GetEnum<QueryMode>(QUERY_MODE_COUNT);
+    options.ranking = reader.GetEnum<RankingModel>(RANKING_MODEL_COUNT);
+    options.bm25.k1 = reader.Get<double>();
+    options.bm25.b = reader.Get<double>();
+    for (uint32_t field_count = reader.Get<uint32_t>(); field_count > 0; --field_count) {
+        const string_view name = reader.GetString();
+        options.field_weights.emplace(name, reader.Get<double>());
+    }
+    options.use_impact_tier = reader.GetEnum<uint8_t>(2) != 0;
+    options.min_tier_recall = reader.Get<double>();
+    return options;
+}
+
+CollectionStatistics ReadStatistics(PayloadReader& reader) {
+    CollectionStatistics statistics;
+    statistics.document_count = reader.Get<int32_t>();
+    statistics.word_count = reader.Get<int64_t>();
+    const uint32_t word_count = reader.Get<uint32_t>();
+    for (uint32_t i = 0; i < word_count; ++i) {
+        const string_view word = reader.GetString();
+        statistics.word_document_counts.emplace(word, reader.Get<int32_t>());
+    }
+    return statistics;
+}
+
+[[noreturn]] void ThrowWorkerError(uint8_t type, const string& message) {
+    if (type == RESPONSE_INVALID_ARGUMENT) {
+        throw invalid_argument(message);
+    }
+    if (type == RESPONSE_OUT_OF_RANGE) {
+        throw out_of_range(message);
+    }
+    throw runtime_error(message);
+}
+
+}  // namespace
+
+SearchWorker::SearchWorker(SearchServer& search_server, const string& address)
+    : search_server_(search_server)
+    , listen_fd_(OpenListeningSocket(address)) {
+    if (address.compare(0, 5, "unix:"s) == 0) {
+        unix_socket_path_ = address.substr(5);
+    }
+}
+
+SearchWorker::~SearchWorker() {
+    Stop();
+    for (auto& thread : connection_threads_) {
+        thread.join();
+    }
+    CloseSocket(listen_fd_);
+    if (!unix_socket_path_.empty()) {
+        unlink(unix_socket_path_.c_str());
+    }
+}
+
+void SearchWorker::Serve() {
+    while (true) {
+        const int fd = accept(listen_fd_, nullptr, nullptr);
+        lock_guard guard(connections_mutex_);
+        if (stopping_) {
+            CloseSocket(fd);
+            return;
+        }
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return;
+        }
+        JoinFinishedThreads();
+        connection_fds_.push_back(fd);
+        connection_threads_.emplace_back([this, fd] { ServeConnection(fd); });
+    }
+}
+
+void SearchWorker::Stop() {
+    lock_guard guard(connections_mutex_);
+    stopping_ = true;
+    shutdown(listen_fd_, SHUT_RDWR);
+    for (int fd : connection_fds_) {
+        shutdown(fd, SHUT_RDWR);
+    }
+}
+
+void SearchWorker::ServeConnection(int fd) {
+    uint8_t type;
+    string payload;
+    while (ReceiveFrame(fd, type, payload, SocketClock::time_point::max())) {
+        uint8_t response_type = RESPONSE_OK;
+        string response;
+        try {
+            response = HandleRequest(type, payload);
+        } catch (const invalid_argument& error) {
+            response_type = RESPONSE_INVALID_ARGUMENT;
+            response = error.what();
+        } catch (const out_of_range& error) {
+            response_type = RESPONSE_OUT_OF_RANGE;
+            response = error.what();
+        } catch (const exception& error) {
+            response_type = RESPONSE_ERROR;
+            response = error.what();
+        }
+        if (!SendFrame(fd, response_type, response, SocketClock::time_point::max())) {
+            break;
+        }
+    }
+    lock_guard guard(connections_mutex_);
+    connection_fds_.erase(find(connection_fds_.begin(), connection_fds_.end(), fd));
+    CloseSocket(fd);
+    finished_threads_.push_back(this_thread::get_id());
+}
+
+void SearchWorker::JoinFinishedThreads() {
+    //a finished thread does nothing after releasing the mutex, so joining it does not wait for long
+    for (const thread::id id : finished_threads_) {
+        const auto it = find_if(connection_threads_.begin(), connection_threads_.end(), [id](const thread& thread) {
+            return thread.get_id() == id;
+        });
+        it->join();
+        connection_threads_.erase(it);
+    }
+    finished_threads_.clear();
+}
+
+string SearchWorker::HandleRequest(uint8_t type, string_view payload) {
+    PayloadReader reader(payload);
+    PayloadWriter writer;
+
+    switch (type) {
+    case ADD_DOCUMENT: {
+        const int document_id = reader.Get<int32_t>();
+        const auto status = reader.GetEnum<DocumentStatus>(DOCUMENT_STATUS_COUNT);
+        vector<int> ratings;
+        for (uint32_t rating_count = reader.Get<uint32_t>(); rating_count > 0; --rating_count) {
+            ratings.push_back(reader.Get<int32_t>());
+        }
+        const string_view document = reader.GetString();
+        unique_lock lock(server_mutex_);
+        search_server_.AddDocument(document_id, document, status, ratings);
+        break;
+    }
+    case REMOVE_DOCUMENT: {
+        const int document_id = reader.Get<int32_t>();
+        unique_lock lock(server_mutex_);
+        search_server_.RemoveDocument(document_id);
+        break;
+    }
+    case QUERY_STATISTICS: {
+        const string_view raw_query = reader.GetString();
+        shared_lock lock(server_mutex_);
+        WriteStatistics(writer, search_server_.GetQueryStatistics(raw_query));
+        break;
+    }
+    case FIND_TOP_DOCUMENTS: {
+        const string_view raw_query = reader.GetString();
+        SearchOptions options = ReadSearchOptions(reader);
+        const StatusIs status_filter{reader.GetEnum<DocumentStatus>(DOCUMENT_STATUS_COUNT)};
+        const CollectionStatistics collection = ReadStatistics(reader);
+        options.collection = &collection;
+        shared_lock lock(server_mutex_);
+        const auto documents = search_server_.FindTopDocuments(
+            execution::seq, raw_query, options, status_filter);
+        writer.Put(static_cast<uint32_t>(documents.size()));
+        for (const Document& document : documents) {
+            writer.Put(static_cast<int32_t>(document.id)).Put(document.relevance)
+                  .Put(static_cast<int32_t>(document.rating));
+        }
+        break;
+    }
+    case MATCH_DOCUMENT: {
+        const string_view raw_query = reader.GetString();
+        const int document_id = reader.Get<int32_t>();
+        shared_lock lock(server_mutex_);
+        const auto [words, status] = search_server_.MatchDocument(raw_query, document_id);
+        writer.Put(static_cast<uint8_t>(status)).Put(static_cast<uint32_t>(words.size()));
+        for (string_view word : words) {
+            writer.PutString(word);
+        }
+        break;
+    }
+    default:
+        throw invalid_argument("Неизвестный тип запроса "s + to_string(type));
+    }
+    return move(writer.Data());
+}
+
+bool DistributedSearchResult::IsComplete() const {
+    return responded_workers == total_workers;
+}
+
+SearchCoordinator::SearchCoordinator(vector<string> worker_addresses, chrono::milliseconds timeout)
+    : timeout_(timeout) {
+    if (worker_addresses.empty()) {
+        throw invalid_argument("Не указано ни одного воркера"s);
+    }
+    for (auto& address : worker_addresses) {
+        connections_.push_back({move(address), -1});
+    }
+}
+
+SearchCoordinator::~SearchCoordinator() {
+    for (auto& connection : connections_) {
+        Disconnect(connection);
+    }
+}
+
+void SearchCoordinator::AddDocument(int document_id, string_view document, DocumentStatus status,
+                                    const vector<int>& ratings) {
+    PayloadWriter writer;
+    writer.Put(static_cast<int32_t>(document_id)).Put(static_cast<uint8_t>(status))
+          .Put(static_cast<uint32_t>(ratings.size()));
+    for (int rating : ratings) {
+        writer.Put(static_cast<int32_t>(rating));
+    }
+    writer.PutString(document);
+    lock_guard guard(request_mutex_);
+    Call(GetWorkerIndex(document_id), ADD_DOCUMENT, writer.Data());
+}
+
+void SearchCoordinator::RemoveDocument(int document_id) {
+    PayloadWriter writer;
+    writer.Put(static_cast<int32_t>(document_id));
+    lock_guard guard(request_mutex_);
+    Call(GetWorkerIndex(document_id), REMOVE_DOCUMENT, writer.Data());
+}
+
+DistributedSearchResult SearchCoordinator::FindTopDocuments(string_view raw_query, const SearchOptions& options,
+                                                            StatusIs status_filter) {
+    lock_guard guard(request_mutex_);
+    DistributedSearchResult result;
+    result.total_workers = connections_.size();
+
+    vector<size_t> workers(connections_.size());
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i] = i;
+    }
+
+    //scatter statistics first: IDF has to be computed over all workers which answer
+    PayloadWriter statistics_request;
+    statistics_request.PutString(raw_query);
+    const auto statistics_parts = Broadcast(workers, QUERY_STATISTICS, statistics_request.Data(),
+                                             SocketClock::now() + timeout_);
+    CollectionStatistics collection;
+    vector<size_t> responded;
+    for (size_t i = 0; i < statistics_parts.size(); ++i) {
+        if (statistics_parts[i]) {
+            PayloadReader reader(*statistics_parts[i]);
+            collection.Merge(ReadStatistics(reader));
+            responded.push_back(workers[i]);
+        }
+    }
+    if (responded.empty()) {
+        return result;
+    }
+
+    PayloadWriter find_request;
+    find_request.PutString(raw_query);
+    WriteSearchOptions(find_request, options);
+    find_request.Put(static_cast<uint8_t>(status_filter.status));
+    WriteStatistics(find_request, collection);
+    const auto shard_results = Broadcast(responded, FIND_TOP_DOCUMENTS, find_request.Data(),
+                                         SocketClock::now() + timeout_);
+
+    for (const auto& shard_result : shard_results) {
+        if (!shard_result) {
+            continue;
+        }
+        ++result.responded_workers;
+        PayloadReader reader(*shard_result);
+        const uint32_t document_count = reader.Get<uint32_t>();
+        for (uint32_t i = 0; i < document_count; ++i) {
+            const int id = reader.Get<int32_t>();
+            const double relevance = reader.Get<double>();
+            const int rating = reader.Get<int32_t>();
+            result.documents.emplace_back(id, relevance, rating);
+        }
+    }
+
+    const size_t result_count = min(result.documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    partial_sort(result.documents.begin(), result.documents.begin() + result_count,
+                 result.documents.end(), IsRankedBefore);
+    result.documents.resize(result_count);
+    return result;
+}
+
+DistributedSearchResult SearchCoordinator::FindTopDocuments(string_view raw_query, DocumentStatus status) {
+    return FindTopDocuments(raw_query, SearchOptions{}, StatusIs{status});
+}
+
+DistributedSearchResult SearchCoordinator::FindTopDocuments(string_view raw_query) {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+tuple<vector<string>, DocumentStatus> SearchCoordinator::MatchDocument(string_view raw_query, int document_id) {
+    PayloadWriter writer;
+    writer.PutString(raw_query).Put(static_cast<int32_t>(document_id));
+    lock_guard guard(request_mutex_);
+    const string response = Call(GetWorkerIndex(document_id), MATCH_DOCUMENT, writer.Data());
+
+    PayloadReader reader(response);
+    const auto status = reader.GetEnum<DocumentStatus>(DOCUMENT_STATUS_COUNT);
+    vector<string> words(reader.Get<uint32_t>());
+    for (string& word : words) {
+        word = string(reader.GetString());
+    }
+    return {words, status};
+}
+
+vector<optional<string>> SearchCoordinator::Broadcast(const vector<size_t>& workers, uint8_t type,
+                                                      const string& payload,
+                                                      SocketClock::time_point deadline) {
+    vector<optional<string>> responses(workers.size());
+    vector<bool> sent(workers.size(), false);
+    for (size_t i = 0; i < workers.size(); ++i) {
+        Connection& connection = connections_[workers[i]];
+        if (EnsureConnected(connection, deadline) && SendFrame(connection.fd, type, payload, deadline)) {
+            sent[i] = true;
+        } else {
+            Disconnect(connection);
+        }
+    }
+
+    //workers process the request in parallel, answers are read in order
+    optional<pair<uint8_t, string>> worker_error;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        if (!sent[i]) {
+            continue;
+        }
+        Connection& connection = connections_[workers[i]];
+        uint8_t response_type;
+        string response;
+        if (!ReceiveFrame(connection.fd, response_type, response, deadline)) {
+            //a late answer would desynchronize the connection
+            Disconnect(connection);
+            continue;
+        }
+        if (response_type == RESPONSE_OK) {
+            responses[i] = move(response);
+        } else if (!worker_error) {
+            worker_error = {response_type, move(response)};
+        }
+    }
+    if (worker_error) {
+        ThrowWorkerError(worker_error->first, worker_error->second);
+    }
+    return responses;
+}
+
+string SearchCoordinator::Call(size_t worker, uint8_t type, const string& payload) {
+    auto responses = Broadcast({worker}, type, payload, SocketClock::now() + timeout_);
+    if (!responses[0]) {
+        throw runtime_error("Воркер "s + connections_[worker].address + " не ответил вовремя"s);
+    }
+    return move(*responses[0]);
+}
+
+size_t SearchCoordinator::GetWorkerIndex(int document_id) const {
+    return static_cast<size_t>(document_id) % connections_.size();
+}
+
+bool SearchCoordinator::EnsureConnected(Connection& connection, SocketClock::time_point deadline) {
+    if (connection.fd < 0) {
+        connection.fd = ConnectSocket(connection.address, deadline);
+    }
+    return connection.fd >= 0;
+}
+
+void SearchCoordinator::Disconnect(Connection& connection) {
+    CloseSocket(connection.fd);
+    connection.fd = -1;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "document.h"
+#include "document_predicates.h"
+#include "search_options.h"
+#include "search_server.h"
+#include "socket_io.h"
+
+// Coordinator/worker mode over a compact binary protocol.
+// Address format: "unix:/path/to/socket" or "host:port".
+// Integers are sent in host byte order, so all nodes must share the architecture
+
+// Serves one shard of the collection. Queries run concurrently,
+// AddDocument/RemoveDocument wait for exclusive access
+class SearchWorker {
+public:
+    SearchWorker(SearchServer& search_server, const std::string& address);
+    ~SearchWorker();
+
+    SearchWorker(const SearchWorker&) = delete;
+    SearchWorker& operator=(const SearchWorker&) = delete;
+
+    // Blocks accepting connections until Stop is called
+    void Serve();
+    void Stop();
+
+private:
+    SearchServer& search_server_;
+    std::shared_mutex server_mutex_;
+
+    int listen_fd_ = -1;
+    std::string unix_socket_path_;
+
+    std::mutex connections_mutex_;
+    std::vector<int> connection_fds_;
+    std::vector<std::thread> connection_threads_;
+    // Threads of closed connections, joined at the next accept so that the threads
+    // of a long-running worker do not pile up
+    std::vector<std::thread::id> finished_threads_;
+    bool stopping_ = false;
+
+    void ServeConnection(int fd);
+    // Under connections_mutex_
+    void JoinFinishedThreads();
+    std::string HandleRequest(uint8_t type, std::string_view payload);
+};
+
+struct DistributedSearchResult {
+    std::vector<Document> documents;
+    size_t responded_workers = 0;
+    size_t total_workers = 0;
+
+    // false — some workers did not answer in time, results may miss their documents
+    bool IsComplete() const;
+};
+
+// Routes documents to workers by doc_id % worker count and merges their answers.
+// The timeout applies to every round trip: a search makes two of them.
+// Requests are executed one at a time; use several coordinators for concurrent queries
+class SearchCoordinator {
+public:
+    SearchCoordinator(std::vector<std::string> worker_addresses, std::chrono::milliseconds timeout);
+    ~SearchCoordinator();
+
+    SearchCoordinator(const SearchCoordinator&) = delete;
+    SearchCoordinator& operator=(const SearchCoordinator&) = delete;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status,
+                     const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    DistributedSearchResult FindTopDocuments(std::string_view raw_query, const SearchOptions& options,
+                                             StatusIs status_filter);
+    DistributedSearchResult FindTopDocuments(std::string_view raw_query, DocumentStatus status);
+    DistributedSearchResult FindTopDocuments(std::string_view raw_query);
+
+    // Words are returned as strings, the worker's storage is not shared
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(std::string_view raw_query,
+                                                                       int document_id);
+
+private:
+    struct Connection {
+        std::string address;
+        int fd = -1;
+    };
+
+    std::vector<Connection> connections_;
+    const std::chrono::milliseconds timeout_;
+    std::mutex request_mutex_;
+
+    // Sends the request to the given workers, then collects responses until the deadline.
+    // A worker which failed or timed out gets an empty optional and is reconnected next time
+    std::vector<std::optional<std::string>> Broadcast(const std::vector<size_t>& workers, uint8_t type,
+                                                      const std::string& payload,
+                                                      SocketClock::time_point deadline);
+    std::string Call(size_t worker, uint8_t type, const std::string& payload);
+
+    size_t GetWorkerIndex(int document_id) const;
+    bool EnsureConnected(Connection& connection, SocketClock::time_point deadline);
+    static void Disconnect(Connection& connection);
+};
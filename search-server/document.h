@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <string_view>
 
 struct Document {
     Document();
@@ -18,3 +19,11 @@ enum class DocumentStatus {
     BANNED,
     REMOVED,
 };
+
+const int DOCUMENT_STATUS_COUNT = 4;
+
+// A named part of a document such as its title, body or tags
+struct DocumentField {
+    std::string_view name;
+    std::string_view text;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "document.h"
+
+// Predicates that SearchServer recognizes at compile time. Instead of being called
+// for every posting they are answered from per-status bitmaps or the flat array of
+// document ratings. Any other callable with the same signature takes the generic path
+
+struct StatusIs {
+    DocumentStatus status;
+
+    bool operator()(int /*document_id*/, DocumentStatus document_status, int /*rating*/) const {
+        return document_status == status;
+    }
+};
+
+struct AnyDocument {
+    bool operator()(int /*document_id*/, DocumentStatus /*document_status*/, int /*rating*/) const {
+        return true;
+    }
+};
+
+struct RatingAtLeast {
+    int min_rating;
+
+    bool operator()(int /*document_id*/, DocumentStatus /*document_status*/, int rating) const {
+        return rating >= min_rating;
+    }
+};
@@ -0,0 +1,673 @@
+#include "durable_search_server.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+enum RecordType : uint8_t {
+    ADD_DOCUMENT = 1,
+    REMOVE_DOCUMENT,
+};
+
+// Checkpoint: magic, uint64 lsn, documents, uint32 document count, uint32 crc32 of all before.
+// The count comes last, so that the checkpoint is written in one pass
+const char CHECKPOINT_MAGIC[8] = {'S', 'S', 'C', 'K', 'P', 'T', '0', '2'};
+const size_t CHECKPOINT_HEADER_SIZE = sizeof(CHECKPOINT_MAGIC) + sizeof(uint64_t);
+const size_t CHECKPOINT_TRAILER_SIZE = 2 * sizeof(uint32_t);
+const size_t CHECKPOINT_BUFFER_SIZE = 1 << 20;
+
+// Log record: uint32 body size, uint32 crc32 of the body, body.
+// Body: uint64 lsn, uint8 type, fields of the operation
+const size_t RECORD_HEADER_SIZE = 8;
+
+// Continues crc, the crc32 of the data before, over data; 0 to start
+uint32_t ExtendCrc32(uint32_t crc, string_view data) {
+    static const auto table = [] {
+        array<uint32_t, 256> result{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+            }
+            result[i] = value;
+        }
+        return result;
+    }();
+    crc ^= 0xFFFFFFFFu;
+    for (const char c : data) {
+        crc = table[(crc ^ static_cast<uint8_t>(c)) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+uint32_t ComputeCrc32(string_view data) {
+    return ExtendCrc32(0, data);
+}
+
+template <typename Number>
+void Put(string& out, Number value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void PutString(string& out, string_view text) {
+    Put(out, static_cast<uint32_t>(text.size()));
+    out.append(text);
+}
+
+class Reader {
+public:
+    explicit Reader(string_view data)
+        : data_(data) {
+    }
+
+    template <typename Number>
+    bool Get(Number& value) {
+        if (data_.size() < sizeof(value)) {
+            return false;
+        }
+        memcpy(&value, data_.data(), sizeof(value));
+        data_.remove_prefix(sizeof(value));
+        return true;
+    }
+
+    bool GetString(string_view& text) {
+        uint32_t size;
+        if (!Get(size) || data_.size() < size) {
+            return false;
+        }
+        text = data_.substr(0, size);
+        data_.remove_prefix(size);
+        return true;
+    }
+
+    size_t Left() const {
+        return data_.size();
+    }
+
+private:
+    string_view data_;
+};
+
+// The same fields in a checkpoint and in the body of an ADD_DOCUMENT record
+struct StoredDocument {
+    int32_t id = 0;
+    uint8_t status = 0;
+    int32_t rating = 0;
+    string_view text;
+};
+
+void PutDocument(string& out, const StoredDocument& document) {
+    Put(out, document.id);
+    Put(out, document.status);
+    Put(out, document.rating);
+    PutString(out, document.text);
+}
+
+// false — the document is cut short or its status is out of range
+bool GetDocument(Reader& reader, StoredDocument& document) {
+    return reader.Get(document.id) && reader.Get(document.status) && document.status < DOCUMENT_STATUS_COUNT
+        && reader.Get(document.rating) && reader.GetString(document.text);
+}
+
+// A file mapped for reading, so that checkpoints and segments are not copied into memory;
+// empty if the file does not exist
+class MappedFile {
+public:
+    explicit MappedFile(const string& path) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat file_stat{};
+        if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+            void* data = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                data_ = string_view(static_cast<const char*>(data), static_cast<size_t>(file_stat.st_size));
+            }
+        }
+        const int error = errno;
+        close(fd);
+        if (file_stat.st_size > 0 && data_.empty()) {
+            throw runtime_error("Не удалось прочитать "s + path + ": "s + strerror(error));
+        }
+    }
+
+    MappedFile(MappedFile&& other) noexcept
+        : data_(exchange(other.data_, string_view())) {
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    ~MappedFile() {
+        if (!data_.empty()) {
+            munmap(const_cast<char*>(data_.data()), data_.size());
+        }
+    }
+
+    string_view GetData() const {
+        return data_;
+    }
+
+private:
+    string_view data_;
+};
+
+struct LogRecord {
+    uint64_t lsn = 0;
+    uint8_t type = 0;
+    // Only the id for REMOVE_DOCUMENT
+    StoredDocument document;
+};
+
+// Calls action(record) for the records of a segment up to the first damaged one, a torn
+// write of the last batch before a crash. Returns the size of the valid records
+template <typename Action>
+size_t ForEachLogRecord(string_view content, Action action) {
+    size_t valid_size = 0;
+    while (content.size() - valid_size >= RECORD_HEADER_SIZE) {
+        Reader header(content.substr(valid_size, RECORD_HEADER_SIZE));
+        uint32_t body_size = 0;
+        uint32_t crc = 0;
+        if (!header.Get(body_size) || !header.Get(crc)
+            || content.size() - valid_size - RECORD_HEADER_SIZE < body_size) {
+            break;
+        }
+        const string_view body = content.substr(valid_size + RECORD_HEADER_SIZE, body_size);
+        if (ComputeCrc32(body) != crc) {
+            break;
+        }
+        Reader reader(body);
+        LogRecord record;
+        if (!reader.Get(record.lsn) || !reader.Get(record.type)) {
+            break;
+        }
+        //a body which passed the crc but does not parse is treated as the torn tail as well
+        const bool is_complete = record.type == ADD_DOCUMENT ? GetDocument(reader, record.document)
+                               : record.type == REMOVE_DOCUMENT && reader.Get(record.document.id);
+        if (!is_complete) {
+            break;
+        }
+        action(record);
+        valid_size += RECORD_HEADER_SIZE + body_size;
+    }
+    return valid_size;
+}
+
+[[noreturn]] void ThrowDamagedCheckpoint(const string& path) {
+    throw runtime_error("Повреждён файл контрольной точки "s + path);
+}
+
+// The lsn from the header, without reading the documents
+uint64_t GetCheckpointLsn(string_view content, const string& path) {
+    if (content.size() < CHECKPOINT_HEADER_SIZE + CHECKPOINT_TRAILER_SIZE
+        || memcmp(content.data(), CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0) {
+        ThrowDamagedCheckpoint(path);
+    }
+    Reader header(content.substr(sizeof(CHECKPOINT_MAGIC), sizeof(uint64_t)));
+    uint64_t checkpoint_lsn = 0;
+    if (!header.Get(checkpoint_lsn)) {
+        ThrowDamagedCheckpoint(path);
+    }
+    return checkpoint_lsn;
+}
+
+// Checks the checkpoint and calls action(document) for its documents; returns its lsn
+template <typename Action>
+uint64_t ForEachCheckpointDocument(string_view content, const string& path, Action action) {
+    const uint64_t checkpoint_lsn = GetCheckpointLsn(content, path);
+    Reader trailer(content.substr(content.size() - CHECKPOINT_TRAILER_SIZE));
+    uint32_t document_count = 0;
+    uint32_t stored_crc = 0;
+    if (!trailer.Get(document_count) || !trailer.Get(stored_crc)
+        || ComputeCrc32(content.substr(0, content.size() - sizeof(stored_crc))) != stored_crc) {
+        //rename is atomic, so a checkpoint can only be damaged on the disk itself
+        ThrowDamagedCheckpoint(path);
+    }
+
+    Reader reader(content.substr(CHECKPOINT_HEADER_SIZE,
+                                 content.size() - CHECKPOINT_HEADER_SIZE - CHECKPOINT_TRAILER_SIZE));
+    uint32_t read_count = 0;
+    StoredDocument document;
+    while (reader.Left() > 0) {
+        if (!GetDocument(reader, document)) {
+            ThrowDamagedCheckpoint(path);
+        }
+        action(document);
+        ++read_count;
+    }
+    if (read_count != document_count) {
+        ThrowDamagedCheckpoint(path);
+    }
+    return checkpoint_lsn;
+}
+
+void WriteAllOrThrow(int fd, string_view data, const string& path) {
+    while (!data.empty()) {
+        const ssize_t written = write(fd, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw runtime_error("Ошибка записи в "s + path + ": "s + strerror(errno));
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+}
+
+// Makes created, renamed and deleted files of the directory durable
+void SyncDirectory(const string& directory) {
+    const int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0 || fsync(fd) != 0) {
+        const int error = errno;
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw runtime_error("Ошибка синхронизации каталога "s + directory + ": "s + strerror(error));
+    }
+    close(fd);
+}
+
+// Writes a checkpoint file through a buffer of CHECKPOINT_BUFFER_SIZE, so that the whole
+// corpus is never held in memory
+class CheckpointWriter {
+public:
+    CheckpointWriter(const string& path, uint64_t checkpoint_lsn)
+        : path_(path)
+        , fd_(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)) {
+        if (fd_ < 0) {
+            throw runtime_error("Не удалось создать "s + path_ + ": "s + strerror(errno));
+        }
+        buffer_.reserve(CHECKPOINT_BUFFER_SIZE);
+        buffer_.append(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+        Put(buffer_, checkpoint_lsn);
+    }
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    ~CheckpointWriter() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    void Add(const StoredDocument& document) {
+        PutDocument(buffer_, document);
+        ++document_count_;
+        if (buffer_.size() >= CHECKPOINT_BUFFER_SIZE) {
+            Flush();
+        }
+    }
+
+    // Writes the trailer and syncs the file
+    void Finish() {
+        Put(buffer_, document_count_);
+        Flush();
+        Put(buffer_, crc_);
+        WriteAllOrThrow(fd_, buffer_, path_);
+        if (fsync(fd_) != 0) {
+            throw runtime_error("Ошибка синхронизации "s + path_ + ": "s + strerror(errno));
+        }
+        const int fd = exchange(fd_, -1);
+        if (close(fd) != 0) {
+            throw runtime_error("Ошибка записи в "s + path_ + ": "s + strerror(errno));
+        }
+    }
+
+private:
+    const string path_;
+    int fd_;
+    string buffer_;
+    uint32_t crc_ = 0;
+    uint32_t document_count_ = 0;
+
+    void Flush() {
+        crc_ = ExtendCrc32(crc_, buffer_);
+        WriteAllOrThrow(fd_, buffer_, path_);
+        buffer_.clear();
+    }
+};
+
+const string SEGMENT_PREFIX = "wal-"s;
+const string SEGMENT_SUFFIX = ".log"s;
+
+// Numbers of the log segments in the directory, ascending
+vector<uint64_t> ListSegments(const string& directory) {
+    vector<uint64_t> segments;
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        return segments;
+    }
+    while (const dirent* entry = readdir(dir)) {
+        const string_view name = entry->d_name;
+        if (name.size() <= SEGMENT_PREFIX.size() + SEGMENT_SUFFIX.size()
+            || name.substr(0, SEGMENT_PREFIX.size()) != SEGMENT_PREFIX
+            || name.substr(name.size() - SEGMENT_SUFFIX.size()) != SEGMENT_SUFFIX) {
+            continue;
+        }
+        const string_view number = name.substr(SEGMENT_PREFIX.size(),
+                                               name.size() - SEGMENT_PREFIX.size() - SEGMENT_SUFFIX.size());
+        if (all_of(number.begin(), number.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            segments.push_back(stoull(string(number)));
+        }
+    }
+    closedir(dir);
+    sort(segments.begin(), segments.end());
+    return segments;
+}
+
+}  // namespace
+
+DurableSearchServer::DurableSearchServer(SearchServer& search_server, const string& directory,
+                                         DurabilityOptions options)
+    : search_server_(search_server)
+    , directory_(directory)
+    , checkpoint_path_(directory + "/checkpoint.dat"s)
+    , options_(options) {
+    mkdir(directory.c_str(), 0755);
+    Recover();
+    committer_ = thread([this] { CommitLoop(); });
+    checkpointer_ = thread([this] { CheckpointLoop(); });
+}
+
+DurableSearchServer::~DurableSearchServer() {
+    {
+        lock_guard guard(mutex_);
+        stopping_ = true;
+    }
+    has_records_.notify_one();
+    has_sealed_segments_.notify_one();
+    committer_.join();
+    //segments left unfolded are replayed by the next recovery
+    checkpointer_.join();
+    close(log_fd_);
+}
+
+void DurableSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
+                                      const vector<int>& ratings) {
+    search_server_.AddDocument(document_id, document, status, ratings);
+
+    string body;
+    PutDocument(body, {document_id, static_cast<uint8_t>(status),
+                       static_cast<int32_t>(search_server_.GetDocumentRating(document_id)), document});
+    AppendRecord(ADD_DOCUMENT, body);
+}
+
+void DurableSearchServer::RemoveDocument(int document_id) {
+    search_server_.RemoveDocument(document_id);
+
+    string body;
+    Put(body, static_cast<int32_t>(document_id));
+    AppendRecord(REMOVE_DOCUMENT, body);
+}
+
+void DurableSearchServer::WaitDurable() {
+    unique_lock lock(mutex_);
+    const uint64_t target = last_lsn_;
+    flush_requested_ = true;
+    has_records_.notify_one();
+    committed_.wait(lock, [this, target] { return durable_lsn_ >= target || commit_error_; });
+    if (commit_error_) {
+        rethrow_exception(commit_error_);
+    }
+}
+
+void DurableSearchServer::Checkpoint() {
+    WaitDurable();
+    uint64_t target;
+    {
+        lock_guard log_guard(log_mutex_);
+        target = active_segment_;
+        SealSegment();
+    }
+    unique_lock lock(mutex_);
+    checkpointed_.wait(lock, [this, target] { return attempted_segment_ >= target; });
+    if (folded_segment_ < target) {
+        rethrow_exception(checkpoint_error_);
+    }
+}
+
+const SearchServer& DurableSearchServer::GetSearchServer() const {
+    return search_server_;
+}
+
+string DurableSearchServer::GetSegmentPath(uint64_t segment) const {
+    return directory_ + "/"s + SEGMENT_PREFIX + to_string(segment) + SEGMENT_SUFFIX;
+}
+
+void DurableSearchServer::Recover() {
+    const uint64_t checkpoint_lsn = LoadCheckpoint();
+    last_lsn_ = checkpoint_lsn;
+    const vector<uint64_t> segments = ListSegments(directory_);
+    for (const uint64_t segment : segments) {
+        ReplaySegment(segment, checkpoint_lsn);
+    }
+    durable_lsn_ = last_lsn_;
+
+    //the segments found are folded in the background; writing goes on in a new one, so
+    //that nothing is appended after a torn tail
+    active_segment_ = segments.empty() ? 1 : segments.back() + 1;
+    folded_segment_ = segments.empty() ? 0 : segments.front() - 1;
+    attempted_segment_ = folded_segment_;
+    sealed_segment_ = active_segment_ - 1;
+    //O_APPEND keeps the writes of a batch together at the end of the segment
+    log_fd_ = open(GetSegmentPath(active_segment_).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (log_fd_ < 0) {
+        throw runtime_error("Не удалось открыть журнал "s + GetSegmentPath(active_segment_) + ": "s + strerror(errno));
+    }
+    SyncDirectory(directory_);
+}
+
+uint64_t DurableSearchServer::LoadCheckpoint() {
+    const MappedFile checkpoint(checkpoint_path_);
+    if (checkpoint.GetData().empty()) {
+        return 0;
+    }
+    return ForEachCheckpointDocument(checkpoint.GetData(), checkpoint_path_, [this](const StoredDocument& document) {
+        search_server_.AddDocument(document.id, document.text, static_cast<DocumentStatus>(document.status),
+                                   {document.rating});
+    });
+}
+
+void DurableSearchServer::ReplaySegment(uint64_t segment, uint64_t checkpoint_lsn) {
+    const MappedFile content(GetSegmentPath(segment));
+    ForEachLogRecord(content.GetData(), [this, checkpoint_lsn](const LogRecord& record) {
+        //records folded into the checkpoint stay until their segment is deleted
+        if (record.lsn <= checkpoint_lsn) {
+            return;
+        }
+        const StoredDocument& document = record.document;
+        if (record.type == ADD_DOCUMENT) {
+            search_server_.AddDocument(document.id, document.text, static_cast<DocumentStatus>(document.status),
+                                       {document.rating});
+        } else if (record.type == REMOVE_DOCUMENT) {
+            search_server_.RemoveDocument(document.id);
+        }
+        last_lsn_ = record.lsn;
+    });
+}
+
+void DurableSearchServer::AppendRecord(uint8_t type, string_view body) {
+    lock_guard guard(mutex_);
+    string record_body;
+    Put(record_body, ++last_lsn_);
+    Put(record_body, type);
+    record_body.append(body);
+    Put(pending_records_, static_cast<uint32_t>(record_body.size()));
+    Put(pending_records_, ComputeCrc32(record_body));
+    pending_records_ += record_body;
+}
+
+void DurableSearchServer::CommitLoop() {
+    unique_lock lock(mutex_);
+    while (true) {
+        //records of one interval go to the disk as one batch
+        has_records_.wait_for(lock, options_.commit_interval, [this] {
+            return stopping_ || flush_requested_;
+        });
+        flush_requested_ = false;
+        if (pending_records_.empty()) {
+            if (stopping_) {
+                return;
+            }
+            continue;
+        }
+
+        string batch;
+        batch.swap(pending_records_);
+        const uint64_t batch_lsn = last_lsn_;
+        lock.unlock();
+        exception_ptr error;
+        {
+            lock_guard log_guard(log_mutex_);
+            try {
+                WriteAllOrThrow(log_fd_, batch, GetSegmentPath(active_segment_));
+                if (fdatasync(log_fd_) != 0) {
+                    throw runtime_error("Ошибка синхронизации журнала "s + GetSegmentPath(active_segment_)
+                                        + ": "s + strerror(errno));
+                }
+                log_size_ += batch.size();
+                if (options_.checkpoint_log_bytes > 0 && log_size_ >= options_.checkpoint_log_bytes) {
+                    SealSegment();
+                }
+            } catch (...) {
+                error = current_exception();
+            }
+        }
+        lock.lock();
+        if (error) {
+            //the following records can not be made durable either
+            commit_error_ = error;
+            committed_.notify_all();
+            return;
+        }
+        durable_lsn_ = batch_lsn;
+        committed_.notify_all();
+    }
+}
+
+void DurableSearchServer::SealSegment() {
+    //every batch written to the active segment is synced already
+    const uint64_t next_segment = active_segment_ + 1;
+    const int fd = open(GetSegmentPath(next_segment).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        throw runtime_error("Не удалось создать журнал "s + GetSegmentPath(next_segment) + ": "s + strerror(errno));
+    }
+    try {
+        SyncDirectory(directory_);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(log_fd_);
+    log_fd_ = fd;
+    log_size_ = 0;
+    {
+        lock_guard guard(mutex_);
+        sealed_segment_ = active_segment_;
+    }
+    active_segment_ = next_segment;
+    has_sealed_segments_.notify_one();
+}
+
+void DurableSearchServer::CheckpointLoop() {
+    unique_lock lock(mutex_);
+    while (true) {
+        has_sealed_segments_.wait(lock, [this] {
+            return stopping_ || sealed_segment_ > attempted_segment_;
+        });
+        if (stopping_) {
+            return;
+        }
+        const uint64_t first_segment = folded_segment_ + 1;
+        const uint64_t last_segment = sealed_segment_;
+        lock.unlock();
+        exception_ptr error;
+        try {
+            FoldSegments(first_segment, last_segment);
+        } catch (...) {
+            error = current_exception();
+        }
+        lock.lock();
+        //a failed checkpoint is tried again with the next sealed segment
+        attempted_segment_ = last_segment;
+        if (error) {
+            checkpoint_error_ = error;
+        } else {
+            folded_segment_ = last_segment;
+            checkpoint_error_ = nullptr;
+        }
+        checkpointed_.notify_all();
+    }
+}
+
+void DurableSearchServer::FoldSegments(uint64_t first_segment, uint64_t last_segment) {
+    const MappedFile old_checkpoint(checkpoint_path_);
+    //the old checkpoint is checked while it is copied, before the new one replaces it
+    const uint64_t old_lsn = old_checkpoint.GetData().empty()
+        ? 0 : GetCheckpointLsn(old_checkpoint.GetData(), checkpoint_path_);
+
+    //the last state of every document the segments change; nullopt — removed
+    vector<MappedFile> segments;
+    map<int32_t, optional<StoredDocument>> changes;
+    uint64_t checkpoint_lsn = old_lsn;
+    for (uint64_t segment = first_segment; segment <= last_segment; ++segment) {
+        segments.emplace_back(GetSegmentPath(segment));
+        ForEachLogRecord(segments.back().GetData(), [&](const LogRecord& record) {
+            if (record.lsn <= old_lsn) {
+                return;
+            }
+            if (record.type == ADD_DOCUMENT) {
+                changes[record.document.id] = record.document;
+            } else if (record.type == REMOVE_DOCUMENT) {
+                changes[record.document.id] = nullopt;
+            }
+            checkpoint_lsn = record.lsn;
+        });
+    }
+
+    const string temporary_path = checkpoint_path_ + ".tmp"s;
+    CheckpointWriter writer(temporary_path, checkpoint_lsn);
+    if (!old_checkpoint.GetData().empty()) {
+        ForEachCheckpointDocument(old_checkpoint.GetData(), checkpoint_path_, [&](const StoredDocument& document) {
+            if (changes.count(document.id) == 0) {
+                writer.Add(document);
+            }
+        });
+    }
+    for (const auto& [document_id, document] : changes) {
+        if (document) {
+            writer.Add(*document);
+        }
+    }
+    writer.Finish();
+    if (rename(temporary_path.c_str(), checkpoint_path_.c_str()) != 0) {
+        throw runtime_error("Не удалось заменить "s + checkpoint_path_ + ": "s + strerror(errno));
+    }
+    SyncDirectory(directory_);
+
+    //records of a segment left behind by a crash here are skipped on recovery by their lsn
+    for (uint64_t segment = first_segment; segment <= last_segment; ++segment) {
+        if (unlink(GetSegmentPath(segment).c_str()) != 0) {
+            throw runtime_error("Не удалось удалить "s + GetSegmentPath(segment) + ": "s + strerror(errno));
+        }
+    }
+    SyncDirectory(directory_);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+struct DurabilityOptions {
+    // Records appended within this interval share one fdatasync (group commit)
+    std::chrono::milliseconds commit_interval{5};
+    // A log segment is closed and folded into the checkpoint in the background when it
+    // grows beyond this size; 0 — only by Checkpoint()
+    uint64_t checkpoint_log_bytes = 64ull << 20;
+};
+
+// Keeps a SearchServer recoverable after a crash. Every AddDocument/RemoveDocument is applied
+// to the server and appended to a write-ahead log; a background thread writes the log in
+// batches. The constructor restores the server from the last checkpoint and the log segments.
+//
+// The log is a sequence of segments. A full segment is closed, and the next checkpoint is
+// made from the previous one and the closed segments by another background thread,
+// streamed to the file; the server itself is not read, so writes go on meanwhile.
+//
+// Files in the directory: checkpoint.dat (all documents as of some log position) and
+// wal-<n>.log, the segments not folded into it yet
+class DurableSearchServer {
+public:
+    // search_server should be empty, it is filled from the directory
+    DurableSearchServer(SearchServer& search_server, const std::string& directory,
+                        DurabilityOptions options = {});
+    ~DurableSearchServer();
+
+    DurableSearchServer(const DurableSearchServer&) = delete;
+    DurableSearchServer& operator=(const DurableSearchServer&) = delete;
+
+    // The change is visible at once and durable after the next group commit
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status,
+                     const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    // Blocks until every change made so far is on disk.
+    // Rethrows the error if writing the log has failed
+    void WaitDurable();
+
+    // Closes the log segment and waits until the checkpoint holds every change made so far.
+    // Rethrows the error if writing the checkpoint has failed
+    void Checkpoint();
+
+    const SearchServer& GetSearchServer() const;
+
+private:
+    SearchServer& search_server_;
+    const std::string directory_;
+    const std::string checkpoint_path_;
+    const DurabilityOptions options_;
+    // Guards the active log segment; held while a batch is written and synced and while
+    // the segment is closed, so a segment is closed between batches
+    std::mutex log_mutex_;
+    int log_fd_ = -1;
+    uint64_t active_segment_ = 0;
+    // Bytes in the active segment, under log_mutex_ only
+    uint64_t log_size_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable has_records_;
+    std::condition_variable committed_;
+    std::string pending_records_;
+    uint64_t last_lsn_ = 0;
+    uint64_t durable_lsn_ = 0;
+    bool flush_requested_ = false;
+    bool stopping_ = false;
+    std::exception_ptr commit_error_;
+    // Segments up to sealed_segment_ are closed, those up to folded_segment_ are in the
+    // checkpoint and deleted; the last checkpoint tried took those up to attempted_segment_
+    std::condition_variable has_sealed_segments_;
+    std::condition_variable checkpointed_;
+    uint64_t sealed_segment_ = 0;
+    uint64_t folded_segment_ = 0;
+    uint64_t attempted_segment_ = 0;
+    std::exception_ptr checkpoint_error_;
+    std::thread committer_;
+    std::thread checkpointer_;
+
+    std::string GetSegmentPath(uint64_t segment) const;
+    void Recover();
+    uint64_t LoadCheckpoint();
+    void ReplaySegment(uint64_t segment, uint64_t checkpoint_lsn);
+
+    void AppendRecord(uint8_t type, std::string_view body);
+    void CommitLoop();
+    // Under log_mutex_: opens the next segment and hands the active one to the checkpointer
+    void SealSegment();
+
+    void CheckpointLoop();
+    // Writes the checkpoint of the current one and segments first..last, then deletes them
+    void FoldSegments(uint64_t first_segment, uint64_t last_segment);
+};
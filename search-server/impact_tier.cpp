@@ -0,0 +1,84 @@
+#include "impact_tier.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "memory_usage.h"
+
+using namespace std;
+
+namespace {
+
+void AddToBound(TermScoreBound& bound, const TermImpactTier::Posting& posting) {
+    bound.max_term_freq = max(bound.max_term_freq, static_cast<double>(posting.term_freq));
+    bound.max_term_count = max(bound.max_term_count, posting.term_count);
+    bound.min_document_length = min(bound.min_document_length, posting.document_length);
+}
+
+}  // namespace
+
+ImpactTierIndex::ImpactTierIndex(ImpactTierOptions options, pmr::memory_resource* resource)
+    : options_(options)
+    , tiers_(resource) {
+    if (options_.postings_per_term < 1) {
+        throw invalid_argument("Размер первого уровня индекса должен быть положительным"s);
+    }
+}
+
+void ImpactTierIndex::AddPosting(string_view word, const TermImpactTier::Posting& posting) {
+    TermImpactTier& tier = tiers_[word];
+    const size_t capacity = static_cast<size_t>(options_.postings_per_term);
+    const auto position = upper_bound(tier.postings.begin(), tier.postings.end(), posting,
+        [](const TermImpactTier::Posting& lhs, const TermImpactTier::Posting& rhs) {
+            return static_cast<double>(lhs.term_freq) > static_cast<double>(rhs.term_freq);
+        });
+    //a tier short of postings after removals takes any posting, which keeps the bound valid
+    if (tier.postings.size() < capacity) {
+        tier.postings.insert(position, posting);
+        return;
+    }
+    if (position == tier.postings.end()) {
+        AddToBound(tier.rest_bound, posting);
+        return;
+    }
+    AddToBound(tier.rest_bound, tier.postings.back());
+    tier.postings.pop_back();
+    tier.postings.insert(position, posting);
+}
+
+void ImpactTierIndex::RemovePosting(string_view word, int slot) {
+    const auto it = tiers_.find(word);
+    if (it == tiers_.end()) {
+        return;
+    }
+    auto& postings = it->second.postings;
+    postings.erase(remove_if(postings.begin(), postings.end(),
+        [slot](const TermImpactTier::Posting& posting) {
+            return posting.slot == slot;
+        }), postings.end());
+}
+
+const TermImpactTier* ImpactTierIndex::Find(string_view word) const {
+    const auto it = tiers_.find(word);
+    return it == tiers_.end() ? nullptr : &it->second;
+}
+
+void ImpactTierIndex::CountSearch(bool fell_back) const {
+    searches_.fetch_add(1, memory_order_relaxed);
+    if (fell_back) {
+        fallbacks_.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+ImpactTierStats ImpactTierIndex::GetStats() const {
+    return {searches_.load(memory_order_relaxed), fallbacks_.load(memory_order_relaxed)};
+}
+
+size_t ImpactTierIndex::GetMemoryUsage() const {
+    size_t bytes = GetHashTableMemory(tiers_);
+    for (const auto& [word, tier] : tiers_) {
+        bytes += GetVectorMemory(tier.postings);
+    }
+    return bytes;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "term_frequency.h"
+#include "term_scorers.h"
+
+struct ImpactTierOptions {
+    // Postings kept in the tier per term, those with the largest term frequency
+    int postings_per_term = 64;
+};
+
+// The postings of a term with the largest term frequencies, largest first, and the
+// bound of the postings left out. Every posting not in the tier scores at most the
+// bound, so a document in no tier list of the query words scores at most the sum
+// of the bounds. The bound only grows, as TermScoreBound does.
+// Allocator-aware, so that the tier table passes the index resource down to it
+struct TermImpactTier {
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    explicit TermImpactTier(const allocator_type& allocator = {})
+        : postings(allocator) {
+    }
+    TermImpactTier(const TermImpactTier& other, const allocator_type& allocator)
+        : postings(other.postings, allocator)
+        , rest_bound(other.rest_bound) {
+    }
+    TermImpactTier(TermImpactTier&& other, const allocator_type& allocator)
+        : postings(std::move(other.postings), allocator)
+        , rest_bound(other.rest_bound) {
+    }
+    TermImpactTier(const TermImpactTier&) = default;
+    TermImpactTier(TermImpactTier&&) = default;
+    TermImpactTier& operator=(const TermImpactTier&) = default;
+    TermImpactTier& operator=(TermImpactTier&&) = default;
+
+    // Keyed by the document slot of SearchServer, as the posting lists are
+    struct Posting {
+        int slot;
+        TermFrequency term_freq;
+        int term_count;
+        int document_length;
+    };
+    std::pmr::vector<Posting> postings;
+    TermScoreBound rest_bound;
+};
+
+struct ImpactTierStats {
+    // FindTopDocuments calls that tried the tier, and those of them that fell
+    // back to the full index
+    uint64_t searches = 0;
+    uint64_t fallbacks = 0;
+};
+
+// First tier of a statically pruned index: a small impact-ordered copy of every
+// posting list. Term frequency orders the postings as TF-IDF ranks them; under BM25
+// the bounds still hold, but the tier is less likely to decide the top alone
+class ImpactTierIndex {
+public:
+    // Allocates from resource, as SearchServer allocates its index.
+    // Throws std::invalid_argument unless postings_per_term is positive
+    explicit ImpactTierIndex(ImpactTierOptions options = {},
+                             std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // word must outlive the index
+    void AddPosting(std::string_view word, const TermImpactTier::Posting& posting);
+    // The bound is not tightened when a posting left out is removed
+    void RemovePosting(std::string_view word, int slot);
+
+    // nullptr for a word never added
+    const TermImpactTier* Find(std::string_view word) const;
+
+    void CountSearch(bool fell_back) const;
+    ImpactTierStats GetStats() const;
+
+    // Estimated heap bytes, see memory_usage.h
+    size_t GetMemoryUsage() const;
+
+private:
+    ImpactTierOptions options_;
+    std::pmr::unordered_map<std::string_view, TermImpactTier> tiers_;
+    mutable std::atomic<uint64_t> searches_ = 0;
+    mutable std::atomic<uint64_t> fallbacks_ = 0;
+};
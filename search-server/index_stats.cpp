@@ -0,0 +1,36 @@
+#include "index_stats.h"
+
+#include <iomanip>
+
+using namespace std;
+
+namespace {
+
+double ToMegabytes(size_t bytes) {
+    return bytes / double(1 << 20);
+}
+
+}  // namespace
+
+ostream& operator<<(ostream& out, const IndexStats& stats) {
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << fixed << setprecision(2);
+    for (const IndexPartStats& part : stats.parts) {
+        out << left << setw(24) << part.name << right << setw(12) << part.entries << " entries"s
+            << setw(12) << ToMegabytes(part.bytes) << " MB"s << '\n';
+    }
+    out << left << setw(24) << "total"s << right << setw(32) << ToMegabytes(stats.total_bytes) << " MB"s << '\n';
+    out << "documents = "s << stats.document_count << ", terms = "s << stats.term_count
+        << ", postings = "s << stats.posting_count << ", longest posting list = "s << stats.max_posting_length << '\n';
+    out << "empty terms = "s << stats.empty_term_count << " ("s << ToMegabytes(stats.empty_term_bytes) << " MB)"s
+        << ", removed texts = "s << ToMegabytes(stats.removed_text_bytes) << " MB"s << '\n';
+    out << "posting lengths:"s << '\n';
+    for (size_t i = 0; i < stats.posting_length_counts.size(); ++i) {
+        out << "  ["s << (size_t{1} << i) << ", "s << (size_t{1} << (i + 1)) << ")  "s
+            << stats.posting_length_counts[i] << '\n';
+    }
+    out.flags(flags);
+    out.precision(precision);
+    return out;
+}
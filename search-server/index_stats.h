@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Memory of one part of the index: entries are the nodes or elements of its containers
+struct IndexPartStats {
+    std::string name;
+    size_t entries = 0;
+    size_t bytes = 0;
+};
+
+struct IndexStats {
+    // In the order of the SearchServer members; bytes include the container nodes and
+    // the allocation headers, see memory_usage.h
+    std::vector<IndexPartStats> parts;
+    size_t total_bytes = 0;
+
+    size_t document_count = 0;
+    // Words with at least one document
+    size_t term_count = 0;
+    size_t posting_count = 0;
+    // Bucket i counts the words found in [2^i, 2^(i+1)) documents
+    std::vector<size_t> posting_length_counts;
+    size_t max_posting_length = 0;
+
+    // Words left without documents by RemoveDocument; their keys and empty lists stay
+    size_t empty_term_count = 0;
+    size_t empty_term_bytes = 0;
+    // Texts of removed documents, still kept because words may view them
+    size_t removed_text_bytes = 0;
+};
+
+// A table of the parts and the counts, one value per line
+std::ostream& operator<<(std::ostream& out, const IndexStats& stats);
@@ -0,0 +1,38 @@
+#include "latency_stats.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+chrono::microseconds GetPercentile(vector<chrono::microseconds>& latencies, double percentile) {
+    const size_t position = min(latencies.size() - 1,
+                                static_cast<size_t>(percentile / 100.0 * latencies.size()));
+    nth_element(latencies.begin(), latencies.begin() + position, latencies.end());
+    return latencies[position];
+}
+
+}  // namespace
+
+LatencySummary SummarizeLatencies(vector<chrono::microseconds>& latencies) {
+    LatencySummary summary;
+    summary.count = latencies.size();
+    if (latencies.empty()) {
+        return summary;
+    }
+    summary.p50 = GetPercentile(latencies, 50);
+    summary.p90 = GetPercentile(latencies, 90);
+    summary.p99 = GetPercentile(latencies, 99);
+    summary.max = *max_element(latencies.begin(), latencies.end());
+    return summary;
+}
+
+ostream& operator<<(ostream& out, const LatencySummary& summary) {
+    out << "requests = "s << summary.count
+        << ", p50 = "s << summary.p50.count() << " us"s
+        << ", p90 = "s << summary.p90.count() << " us"s
+        << ", p99 = "s << summary.p99.count() << " us"s
+        << ", max = "s << summary.max.count() << " us"s;
+    return out;
+}
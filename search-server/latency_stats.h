@@ -0,0 +1,18 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+struct LatencySummary {
+    size_t count = 0;
+    std::chrono::microseconds p50{0};
+    std::chrono::microseconds p90{0};
+    std::chrono::microseconds p99{0};
+    std::chrono::microseconds max{0};
+};
+
+// Reorders the samples
+LatencySummary SummarizeLatencies(std::vector<std::chrono::microseconds>& latencies);
+
+std::ostream& operator<<(std::ostream& out, const LatencySummary& summary);
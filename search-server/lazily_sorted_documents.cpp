@@ -0,0 +1,101 @@
+#include "lazily_sorted_documents.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include "term_frequency.h"
+
+using namespace std;
+
+bool IsRankedBefore(const Document& lhs, const Document& rhs) {
+    if (abs(lhs.relevance - rhs.relevance) >= RELEVANCE_EPSILON) {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+bool PageCursor::IsAtStart() const {
+    return document_id < 0;
+}
+
+LazilySortedDocuments::LazilySortedDocuments(vector<Document> documents)
+    : documents_(move(documents))
+    , boundaries_({0, documents_.size()}) {
+}
+
+LazilySortedDocuments::Page LazilySortedDocuments::GetPage(size_t page_index, size_t page_size) {
+    const size_t first = min(page_index * page_size, documents_.size());
+    const size_t last = min(first + page_size, documents_.size());
+    return RankRange(first, last);
+}
+
+LazilySortedDocuments::Page LazilySortedDocuments::GetNextPage(PageCursor& cursor, size_t page_size) {
+    size_t first = 0;
+    if (!cursor.IsAtStart()) {
+        const Document last_shown(cursor.document_id, cursor.relevance, cursor.rating);
+        const auto is_shown = [&last_shown](const Document& document) {
+            return !IsRankedBefore(last_shown, document);
+        };
+        // Only the segment where the cursor falls is split, the segments before it are shown already
+        auto upper = next(boundaries_.begin());
+        while (upper != boundaries_.end()
+               && all_of(documents_.begin() + *prev(upper), documents_.begin() + *upper, is_shown)) {
+            ++upper;
+        }
+        if (upper == boundaries_.end()) {
+            first = documents_.size();
+        } else {
+            const auto segment_begin = documents_.begin() + *prev(upper);
+            const auto segment_end = documents_.begin() + *upper;
+            // A segment which is a ranked page already is partitioned and keeps its order
+            if (!is_partitioned(segment_begin, segment_end, is_shown)) {
+                partition(segment_begin, segment_end, is_shown);
+            }
+            first = static_cast<size_t>(
+                distance(documents_.begin(), partition_point(segment_begin, segment_end, is_shown)));
+            boundaries_.insert(first);
+        }
+    }
+    const size_t last = min(first + page_size, documents_.size());
+    const Page page = RankRange(first, last);
+    if (first != last) {
+        const Document& last_document = documents_[last - 1];
+        cursor = {last_document.relevance, last_document.rating, last_document.id};
+    }
+    return page;
+}
+
+size_t LazilySortedDocuments::size() const {
+    return documents_.size();
+}
+
+bool LazilySortedDocuments::empty() const {
+    return documents_.empty();
+}
+
+void LazilySortedDocuments::SplitAt(size_t position) {
+    const auto upper = boundaries_.lower_bound(position);
+    if (*upper == position) {
+        return;
+    }
+    const auto segment_begin = documents_.begin() + *prev(upper);
+    const auto segment_end = documents_.begin() + *upper;
+    // A returned page must not be reordered
+    if (!is_sorted(segment_begin, segment_end, IsRankedBefore)) {
+        nth_element(segment_begin, documents_.begin() + position, segment_end, IsRankedBefore);
+    }
+    boundaries_.insert(position);
+}
+
+LazilySortedDocuments::Page LazilySortedDocuments::RankRange(size_t first, size_t last) {
+    if (first < last) {
+        SplitAt(first);
+        SplitAt(last);
+        sort(documents_.begin() + first, documents_.begin() + last, IsRankedBefore);
+    }
+    return {documents_.cbegin() + first, documents_.cbegin() + last};
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <set>
+#include <vector>
+
+#include "document.h"
+#include "paginator.h"
+
+// Order of documents in search results: relevance, then rating, then id
+bool IsRankedBefore(const Document& lhs, const Document& rhs);
+
+// Last document of a returned page. Continuing after it does not require
+// ranking or even keeping the pages that were already shown
+struct PageCursor {
+    double relevance = 0.0;
+    int rating = 0;
+    int document_id = -1;  // -1 — no page has been returned yet
+
+    bool IsAtStart() const;
+};
+
+// Scored matched documents which are sorted only as far as pages are requested.
+// A returned page stays valid while the LazilySortedDocuments lives: ranking other pages
+// reorders only the documents which no page has covered
+class LazilySortedDocuments {
+public:
+    using Iterator = std::vector<Document>::const_iterator;
+    using Page = IteratorRange<Iterator>;
+
+    LazilySortedDocuments() = default;
+    explicit LazilySortedDocuments(std::vector<Document> documents);
+
+    // Ranks only the requested page, earlier pages stay unordered
+    Page GetPage(size_t page_index, size_t page_size);
+
+    // Returns the page that follows the cursor and moves the cursor to its end
+    Page GetNextPage(PageCursor& cursor, size_t page_size);
+
+    size_t size() const;
+    bool empty() const;
+
+private:
+    std::vector<Document> documents_;
+    // Every document before a boundary is ranked before every document after it
+    std::set<size_t> boundaries_;
+
+    void SplitAt(size_t position);
+    Page RankRange(size_t first, size_t last);
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Estimates of the heap memory taken by standard containers, for IndexStats. They
+// assume libstdc++ containers on the glibc heap: a block carries an 8-byte header and
+// is rounded up to 16 bytes, 32 at least; a tree node adds 32 bytes of links to the
+// value. A resource other than the default heap takes about the same, less the headers
+
+inline size_t GetAllocationSize(size_t bytes) {
+    return std::max<size_t>(32, (bytes + 8 + 15) & ~size_t{15});
+}
+
+template <typename Tree>
+size_t GetTreeNodeSize() {
+    return GetAllocationSize(32 + sizeof(typename Tree::value_type));
+}
+
+// The nodes only; the memory owned by the values is counted by the caller
+template <typename Tree>
+size_t GetTreeMemory(const Tree& tree) {
+    return tree.size() * GetTreeNodeSize<Tree>();
+}
+
+// The buckets and the nodes, counting a cached hash code in every node
+template <typename HashTable>
+size_t GetHashTableMemory(const HashTable& table) {
+    return GetAllocationSize(table.bucket_count() * sizeof(void*))
+        + table.size() * GetAllocationSize(2 * sizeof(void*) + sizeof(typename HashTable::value_type));
+}
+
+template <typename T, typename Allocator>
+size_t GetVectorMemory(const std::vector<T, Allocator>& values) {
+    return values.capacity() == 0 ? 0 : GetAllocationSize(values.capacity() * sizeof(T));
+}
+
+template <typename Allocator>
+size_t GetVectorMemory(const std::vector<bool, Allocator>& bits) {
+    return bits.capacity() == 0 ? 0 : GetAllocationSize(bits.capacity() / 8);
+}
+
+// The buffer of a string longer than the small string optimization keeps inside
+template <typename Char, typename Traits, typename Allocator>
+size_t GetStringMemory(const std::basic_string<Char, Traits, Allocator>& text) {
+    return text.capacity() < 16 ? 0 : GetAllocationSize(text.capacity() + 1);
+}
+
+// Blocks of 512 bytes and the array of pointers to them
+template <typename T, typename Allocator>
+size_t GetDequeMemory(const std::deque<T, Allocator>& values) {
+    const size_t per_block = sizeof(T) < 512 ? 512 / sizeof(T) : 1;
+    const size_t blocks = values.size() / per_block + 1;
+    return blocks * GetAllocationSize(per_block * sizeof(T))
+        + GetAllocationSize(std::max<size_t>(8, blocks + 2) * sizeof(void*));
+}
@@ -3,6 +3,8 @@
 #include <execution>
 #include <vector>
 #include <list>
+#include <mutex>
+#include <exception>
 
 using namespace std;
 
@@ -11,12 +13,24 @@ std::vector<std::vector<Document>> ProcessQueries(
     const std::vector<std::string>& queries) {
 
     vector<vector<Document>> processed_queries(queries.size());
+    //an exception escaping a parallel algorithm calls std::terminate
+    std::mutex error_mutex;
+    std::exception_ptr error;
     
     std::transform(std::execution::par,
                    queries.begin(), queries.end(), processed_queries.begin(), 
-                  [&search_server](auto &querie) {
-                     return search_server.FindTopDocuments(querie);
+                  [&search_server, &error_mutex, &error](auto &querie) {
+                     try {
+                        return search_server.FindTopDocuments(querie);
+                     } catch (...) {
+                        std::lock_guard guard(error_mutex);
+                        error = std::current_exception();
+                        return vector<Document>{};
+                     }
                   });
+    if (error) {
+        std::rethrow_exception(error);
+    }
         
         return processed_queries;
     }
@@ -0,0 +1,354 @@
+#include "query_front_end.h"
+
+#include <cerrno>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "process_queries.h"
+#include "socket_io.h"
+
+using namespace std;
+
+namespace {
+
+const uint64_t LISTEN_ID = numeric_limits<uint64_t>::max();
+const uint64_t WAKEUP_ID = LISTEN_ID - 1;
+const size_t READ_CHUNK_SIZE = 64 * 1024;
+
+string EscapeJson(string_view text) {
+    string escaped;
+    escaped.reserve(text.size());
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped.push_back('\\');
+            escaped.push_back(c);
+        } else if (static_cast<unsigned char>(c) < ' ') {
+            escaped += ' ';
+        } else {
+            escaped.push_back(c);
+        }
+    }
+    return escaped;
+}
+
+string FormatDocuments(const vector<Document>& documents) {
+    ostringstream out;
+    out.precision(10);
+    out << '[';
+    bool first = true;
+    for (const Document& document : documents) {
+        if (!first) {
+            out << ',';
+        }
+        first = false;
+        out << "{\"document_id\":"s << document.id
+            << ",\"relevance\":"s << document.relevance
+            << ",\"rating\":"s << document.rating << '}';
+    }
+    out << ']';
+    return out.str();
+}
+
+string FormatError(string_view message) {
+    return "{\"error\":\""s + EscapeJson(message) + "\"}"s;
+}
+
+void Subscribe(int epoll_fd, int operation, int fd, uint64_t id, uint32_t events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = id;
+    epoll_ctl(epoll_fd, operation, fd, &event);
+}
+
+}  // namespace
+
+QueryFrontEnd::QueryFrontEnd(const SearchServer& search_server, const string& address,
+                             FrontEndOptions options)
+    : search_server_(search_server)
+    , options_(options)
+    , listen_fd_(OpenListeningSocket(address))
+    , epoll_fd_(epoll_create1(0))
+    , wakeup_fd_(eventfd(0, EFD_NONBLOCK)) {
+    if (epoll_fd_ < 0 || wakeup_fd_ < 0) {
+        CloseSocket(listen_fd_);
+        CloseSocket(epoll_fd_);
+        CloseSocket(wakeup_fd_);
+        throw runtime_error("Не удалось создать epoll"s);
+    }
+    SetNonBlocking(listen_fd_);
+    Subscribe(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, LISTEN_ID, EPOLLIN);
+    Subscribe(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, WAKEUP_ID, EPOLLIN);
+    dispatcher_ = thread([this] { Dispatch(); });
+}
+
+QueryFrontEnd::~QueryFrontEnd() {
+    Stop();
+    dispatcher_.join();
+    for (const auto& [id, connection] : connections_) {
+        CloseSocket(connection.fd);
+    }
+    CloseSocket(listen_fd_);
+    CloseSocket(epoll_fd_);
+    CloseSocket(wakeup_fd_);
+}
+
+void QueryFrontEnd::Serve() {
+    const int MAX_EVENTS = 64;
+    epoll_event events[MAX_EVENTS];
+    while (true) {
+        const int ready = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+        if (ready < 0 && errno != EINTR) {
+            return;
+        }
+        for (int i = 0; i < ready; ++i) {
+            const uint64_t id = events[i].data.u64;
+            if (id == LISTEN_ID) {
+                AcceptConnections();
+            } else if (id == WAKEUP_ID) {
+                uint64_t counter;
+                while (read(wakeup_fd_, &counter, sizeof(counter)) > 0) {
+                }
+                DeliverResponses();
+            } else if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                //both directions are closed, the answers could not be delivered anyway
+                if (connections_.count(id) > 0) {
+                    CloseConnection(id);
+                }
+            } else {
+                if (events[i].events & EPOLLIN) {
+                    ReadConnection(id);
+                }
+                if ((events[i].events & EPOLLOUT) && connections_.count(id) > 0) {
+                    WriteConnection(id);
+                }
+            }
+        }
+        lock_guard guard(mutex_);
+        if (stopping_) {
+            return;
+        }
+    }
+}
+
+void QueryFrontEnd::Stop() {
+    {
+        lock_guard guard(mutex_);
+        stopping_ = true;
+    }
+    has_queries_.notify_all();
+    Wake();
+}
+
+void QueryFrontEnd::Dispatch() {
+    while (true) {
+        vector<PendingQuery> batch;
+        {
+            unique_lock lock(mutex_);
+            has_queries_.wait(lock, [this] { return stopping_ || !pending_queries_.empty(); });
+            //the first query waits a little so that its neighbours share the batch
+            has_queries_.wait_for(lock, options_.batch_window, [this] {
+                return stopping_ || pending_queries_.size() >= options_.max_batch_size;
+            });
+            if (stopping_) {
+                return;
+            }
+            const size_t batch_size = min(pending_queries_.size(), options_.max_batch_size);
+            batch.assign(make_move_iterator(pending_queries_.begin()),
+                         make_move_iterator(pending_queries_.begin() + batch_size));
+            pending_queries_.erase(pending_queries_.begin(), pending_queries_.begin() + batch_size);
+        }
+
+        vector<string> results = ProcessBatch(batch);
+        {
+            lock_guard guard(mutex_);
+            for (size_t i = 0; i < batch.size(); ++i) {
+                responses_.push_back({batch[i].connection_id, move(results[i])});
+            }
+        }
+        Wake();
+    }
+}
+
+vector<string> QueryFrontEnd::ProcessBatch(const vector<PendingQuery>& batch) const {
+    vector<string> queries;
+    queries.reserve(batch.size());
+    for (const PendingQuery& pending : batch) {
+        if (!pending.is_too_long) {
+            queries.push_back(pending.query);
+        }
+    }
+
+    vector<string> query_results;
+    query_results.reserve(queries.size());
+    try {
+        for (const auto& documents : ProcessQueries(search_server_, queries)) {
+            query_results.push_back(FormatDocuments(documents));
+        }
+    } catch (const exception&) {
+        //one bad query fails the whole batch, so the batch is repeated query by query
+        query_results.clear();
+        for (const string& query : queries) {
+            try {
+                query_results.push_back(FormatDocuments(search_server_.FindTopDocuments(query)));
+            } catch (const exception& error) {
+                query_results.push_back(FormatError(error.what()));
+            }
+        }
+    }
+
+    vector<string> results;
+    results.reserve(batch.size());
+    auto query_result = make_move_iterator(query_results.begin());
+    for (const PendingQuery& pending : batch) {
+        results.push_back(pending.is_too_long ? FormatError("Слишком длинный запрос"s) : *query_result++);
+    }
+    return results;
+}
+
+void QueryFrontEnd::AcceptConnections() {
+    while (true) {
+        const int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            return;
+        }
+        SetNonBlocking(fd);
+        const uint64_t id = next_connection_id_++;
+        connections_.emplace(id, Connection{fd, {}, {}});
+        Subscribe(epoll_fd_, EPOLL_CTL_ADD, fd, id, EPOLLIN);
+    }
+}
+
+void QueryFrontEnd::ReadConnection(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    Connection& connection = it->second;
+
+    vector<PendingQuery> queries;
+    char buffer[READ_CHUNK_SIZE];
+    while (true) {
+        const ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                connection.closing = true;
+            }
+            break;
+        }
+        //lines are cut after every chunk, so the input never grows far beyond one line
+        const size_t search_start = connection.input.size();
+        connection.input.append(buffer, static_cast<size_t>(received));
+        size_t line_start = 0;
+        for (size_t line_end = connection.input.find('\n', search_start); line_end != string::npos;
+             line_end = connection.input.find('\n', line_start)) {
+            string query = connection.input.substr(line_start, line_end - line_start);
+            if (!query.empty() && query.back() == '\r') {
+                query.pop_back();
+            }
+            queries.push_back({connection_id, move(query)});
+            line_start = line_end + 1;
+        }
+        connection.input.erase(0, line_start);
+        if (connection.input.size() > options_.max_line_size) {
+            //the client gets an error in place of the query and nothing more is read from it
+            queries.push_back({connection_id, {}, true});
+            connection.input.clear();
+            connection.closing = true;
+            break;
+        }
+    }
+    connection.in_flight += queries.size();
+
+    if (!queries.empty()) {
+        {
+            lock_guard guard(mutex_);
+            pending_queries_.insert(pending_queries_.end(), make_move_iterator(queries.begin()),
+                                    make_move_iterator(queries.end()));
+        }
+        has_queries_.notify_one();
+    }
+    if (connection.closing) {
+        if (connection.in_flight == 0) {
+            CloseConnection(connection_id);
+        } else {
+            //the peer is gone for reading, only the remaining answers are awaited
+            Subscribe(epoll_fd_, EPOLL_CTL_MOD, connection.fd, connection_id,
+                      connection.output.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+        }
+    }
+}
+
+void QueryFrontEnd::WriteConnection(uint64_t connection_id) {
+    Connection& connection = connections_.at(connection_id);
+    size_t written_total = 0;
+    while (written_total < connection.output.size()) {
+        const ssize_t written = send(connection.fd, connection.output.data() + written_total,
+                                     connection.output.size() - written_total, MSG_NOSIGNAL);
+        if (written > 0) {
+            written_total += static_cast<size_t>(written);
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            CloseConnection(connection_id);
+            return;
+        }
+    }
+    connection.output.erase(0, written_total);
+
+    if (connection.output.empty() && connection.closing && connection.in_flight == 0) {
+        CloseConnection(connection_id);
+        return;
+    }
+    const uint32_t events = (connection.closing ? 0u : static_cast<uint32_t>(EPOLLIN))
+        | (connection.output.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+    Subscribe(epoll_fd_, EPOLL_CTL_MOD, connection.fd, connection_id, events);
+}
+
+void QueryFrontEnd::DeliverResponses() {
+    vector<Response> responses;
+    {
+        lock_guard guard(mutex_);
+        responses.swap(responses_);
+    }
+    vector<uint64_t> touched;
+    for (Response& response : responses) {
+        const auto it = connections_.find(response.connection_id);
+        if (it == connections_.end()) {
+            continue;
+        }
+        it->second.output += response.data;
+        it->second.output.push_back('\n');
+        --it->second.in_flight;
+        if (touched.empty() || touched.back() != response.connection_id) {
+            touched.push_back(response.connection_id);
+        }
+    }
+    for (uint64_t connection_id : touched) {
+        if (connections_.count(connection_id) > 0) {
+            WriteConnection(connection_id);
+        }
+    }
+}
+
+void QueryFrontEnd::CloseConnection(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    CloseSocket(it->second.fd);
+    connections_.erase(it);
+}
+
+void QueryFrontEnd::Wake() {
+    const uint64_t one = 1;
+    [[maybe_unused]] const ssize_t written = write(wakeup_fd_, &one, sizeof(one));
+}
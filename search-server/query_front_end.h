@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "search_server.h"
+
+struct FrontEndOptions {
+    // How long the first query of a batch waits for company
+    std::chrono::microseconds batch_window{200};
+    size_t max_batch_size = 256;
+    // A longer query line is answered with an error and its connection is closed
+    size_t max_line_size = 64 * 1024;
+};
+
+// Network front-end over ProcessQueries. Clients send one query per line and get one
+// JSON line per query, in the same order:
+//   [{"document_id":1,"relevance":0.5,"rating":3}, ...] or {"error":"..."}
+// A line longer than max_line_size gets {"error":"..."} and ends the connection
+// One epoll thread serves all connections, a dispatcher thread collects the queries
+// which arrive within batch_window and runs them as one ProcessQueries batch
+class QueryFrontEnd {
+public:
+    QueryFrontEnd(const SearchServer& search_server, const std::string& address,
+                  FrontEndOptions options = {});
+    ~QueryFrontEnd();
+
+    QueryFrontEnd(const QueryFrontEnd&) = delete;
+    QueryFrontEnd& operator=(const QueryFrontEnd&) = delete;
+
+    // Blocks serving connections until Stop is called
+    void Serve();
+    void Stop();
+
+private:
+    struct Connection {
+        int fd;
+        std::string input;
+        std::string output;
+        size_t in_flight = 0;
+        bool closing = false;
+    };
+
+    struct PendingQuery {
+        uint64_t connection_id;
+        std::string query;
+        bool is_too_long = false;
+    };
+
+    struct Response {
+        uint64_t connection_id;
+        std::string data;
+    };
+
+    const SearchServer& search_server_;
+    const FrontEndOptions options_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int wakeup_fd_ = -1;
+
+    std::map<uint64_t, Connection> connections_;
+    uint64_t next_connection_id_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable has_queries_;
+    std::vector<PendingQuery> pending_queries_;
+    std::vector<Response> responses_;
+    bool stopping_ = false;
+    std::thread dispatcher_;
+
+    void Dispatch();
+    std::vector<std::string> ProcessBatch(const std::vector<PendingQuery>& batch) const;
+
+    void AcceptConnections();
+    void ReadConnection(uint64_t connection_id);
+    void WriteConnection(uint64_t connection_id);
+    void DeliverResponses();
+    void CloseConnection(uint64_t connection_id);
+    void Wake();
+};
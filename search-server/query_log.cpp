@@ -0,0 +1,147 @@
+#include "query_log.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const string_view QUERY_LOG_MAGIC = "SSQLOG01"sv;
+const size_t WRITE_BLOCK_SIZE = 64 << 10;
+
+void PutVarint(string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+bool GetVarint(string_view& data, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && !data.empty(); shift += 7) {
+        const uint8_t byte = static_cast<uint8_t>(data[0]);
+        data.remove_prefix(1);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//negative ratings stay short
+uint64_t ZigZag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t UnZigZag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+bool ParseRecord(string_view& data, QueryLogRecord& record) {
+    uint64_t start, latency, filter_kind, filter_value, result_count, query_size;
+    if (!GetVarint(data, start) || !GetVarint(data, latency) || !GetVarint(data, filter_kind)
+        || !GetVarint(data, filter_value) || !GetVarint(data, result_count) || !GetVarint(data, query_size)
+        || data.size() < query_size || filter_kind > static_cast<uint64_t>(QueryFilterKind::CUSTOM)) {
+        return false;
+    }
+    record.start = chrono::microseconds(start);
+    record.latency = chrono::microseconds(latency);
+    record.filter = {static_cast<QueryFilterKind>(filter_kind), static_cast<int>(UnZigZag(filter_value))};
+    record.result_count = static_cast<uint32_t>(result_count);
+    record.query.assign(data.substr(0, query_size));
+    data.remove_prefix(query_size);
+    return true;
+}
+
+}  // namespace
+
+QueryLogWriter::QueryLogWriter(const string& path)
+    : path_(path)
+    , start_time_(chrono::steady_clock::now()) {
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        throw runtime_error("Не удалось создать журнал запросов "s + path + ": "s + strerror(errno));
+    }
+    buffer_.append(QUERY_LOG_MAGIC);
+}
+
+QueryLogWriter::~QueryLogWriter() {
+    try {
+        Flush();
+    } catch (const runtime_error&) {
+        //the records are lost, nothing else to do in a destructor
+    }
+    close(fd_);
+}
+
+chrono::steady_clock::time_point QueryLogWriter::GetStartTime() const {
+    return start_time_;
+}
+
+void QueryLogWriter::Append(const QueryLogRecord& record) {
+    lock_guard guard(mutex_);
+    PutVarint(buffer_, static_cast<uint64_t>(record.start.count()));
+    PutVarint(buffer_, static_cast<uint64_t>(record.latency.count()));
+    PutVarint(buffer_, static_cast<uint64_t>(record.filter.kind));
+    PutVarint(buffer_, ZigZag(record.filter.value));
+    PutVarint(buffer_, record.result_count);
+    PutVarint(buffer_, record.query.size());
+    buffer_.append(record.query);
+    if (buffer_.size() >= WRITE_BLOCK_SIZE) {
+        WriteBuffer();
+    }
+}
+
+void QueryLogWriter::Flush() {
+    lock_guard guard(mutex_);
+    WriteBuffer();
+}
+
+void QueryLogWriter::WriteBuffer() {
+    string_view data = buffer_;
+    while (!data.empty()) {
+        const ssize_t written = write(fd_, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw runtime_error("Ошибка записи в "s + path_ + ": "s + strerror(errno));
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+    buffer_.clear();
+}
+
+vector<QueryLogRecord> ReadQueryLog(const string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Не удалось открыть журнал запросов "s + path + ": "s + strerror(errno));
+    }
+    string content;
+    char buffer[1 << 16];
+    ssize_t received;
+    while ((received = read(fd, buffer, sizeof(buffer))) > 0) {
+        content.append(buffer, static_cast<size_t>(received));
+    }
+    close(fd);
+    if (received < 0 || content.compare(0, QUERY_LOG_MAGIC.size(), QUERY_LOG_MAGIC) != 0) {
+        throw runtime_error("Файл "s + path + " не является журналом запросов"s);
+    }
+
+    vector<QueryLogRecord> records;
+    string_view data(content);
+    data.remove_prefix(QUERY_LOG_MAGIC.size());
+    QueryLogRecord record;
+    while (!data.empty() && ParseRecord(data, record)) {
+        records.push_back(move(record));
+    }
+    return records;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "document.h"
+#include "document_predicates.h"
+
+// The filter a request was made with. The built-in predicates are recorded with their
+// argument; any other callable can not be, it is replayed as the ACTUAL status filter
+enum class QueryFilterKind : uint8_t {
+    STATUS,
+    RATING_AT_LEAST,
+    ANY_DOCUMENT,
+    CUSTOM,
+};
+
+struct QueryFilter {
+    QueryFilterKind kind = QueryFilterKind::STATUS;
+    // The status or the minimum rating
+    int value = static_cast<int>(DocumentStatus::ACTUAL);
+};
+
+template <typename DocumentPredicate>
+QueryFilter DescribeFilter(const DocumentPredicate& document_predicate) {
+    if constexpr (std::is_same_v<DocumentPredicate, StatusIs>) {
+        return {QueryFilterKind::STATUS, static_cast<int>(document_predicate.status)};
+    } else if constexpr (std::is_same_v<DocumentPredicate, RatingAtLeast>) {
+        return {QueryFilterKind::RATING_AT_LEAST, document_predicate.min_rating};
+    } else if constexpr (std::is_same_v<DocumentPredicate, AnyDocument>) {
+        return {QueryFilterKind::ANY_DOCUMENT, 0};
+    } else {
+        return {QueryFilterKind::CUSTOM, 0};
+    }
+}
+
+struct QueryLogRecord {
+    // When the request started, from the creation of the log
+    std::chrono::microseconds start{0};
+    std::chrono::microseconds latency{0};
+    std::string query;
+    QueryFilter filter;
+    uint32_t result_count = 0;
+};
+
+// Appends records to a binary log: a magic string, then per record varints of the start,
+// the latency, the filter, the result count and the query length, and the query bytes.
+// Records are buffered and written in blocks; several threads may append at once.
+// Throws std::runtime_error if the file can not be created or written
+class QueryLogWriter {
+public:
+    explicit QueryLogWriter(const std::string& path);
+    ~QueryLogWriter();
+
+    QueryLogWriter(const QueryLogWriter&) = delete;
+    QueryLogWriter& operator=(const QueryLogWriter&) = delete;
+
+    // The origin of QueryLogRecord::start
+    std::chrono::steady_clock::time_point GetStartTime() const;
+
+    void Append(const QueryLogRecord& record);
+    void Flush();
+
+private:
+    const std::string path_;
+    const std::chrono::steady_clock::time_point start_time_;
+    std::mutex mutex_;
+    int fd_ = -1;
+    std::string buffer_;
+
+    void WriteBuffer();
+};
+
+// All complete records of the log; a record cut off by a crash ends the log.
+// Throws std::runtime_error if the file can not be read or is not a query log
+std::vector<QueryLogRecord> ReadQueryLog(const std::string& path);
@@ -0,0 +1,70 @@
+#include "query_scratch.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const size_t INITIAL_ARENA_SIZE = 64 << 10;
+
+// Upstream of the arena; remembers how much did not fit into the buffer
+class OverflowResource : public pmr::memory_resource {
+public:
+    size_t overflow_bytes = 0;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        overflow_bytes += bytes;
+        return pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+        pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+    }
+
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+struct ThreadScratch {
+    vector<byte> buffer;
+    OverflowResource overflow;
+    optional<pmr::monotonic_buffer_resource> arena;
+    int depth = 0;
+
+    void Rewind() {
+        arena.reset();
+        if (buffer.empty() || overflow.overflow_bytes > 0) {
+            //grow once to the high-water mark instead of spilling on every query
+            buffer = vector<byte>(max(INITIAL_ARENA_SIZE, 2 * (buffer.size() + overflow.overflow_bytes)));
+            overflow.overflow_bytes = 0;
+        }
+        arena.emplace(buffer.data(), buffer.size(), &overflow);
+    }
+};
+
+thread_local ThreadScratch thread_scratch;
+
+}  // namespace
+
+QueryScratch::Scope::Scope() {
+    if (thread_scratch.depth++ == 0) {
+        thread_scratch.Rewind();
+    }
+}
+
+QueryScratch::Scope::~Scope() {
+    --thread_scratch.depth;
+}
+
+pmr::memory_resource* QueryScratch::GetResource() {
+    if (thread_scratch.depth == 0) {
+        return pmr::get_default_resource();
+    }
+    return &*thread_scratch.arena;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <memory_resource>
+
+// Per-thread memory for the temporaries of queries: parsed words, candidate lists,
+// matched documents. The outermost Scope of a thread rewinds the arena, so queries
+// do not allocate once the arena has grown to the largest query seen.
+// Nested scopes (a TBB worker picking up another query while it waits) share the arena
+class QueryScratch {
+public:
+    class Scope {
+    public:
+        Scope();
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    // The arena of the innermost scope of this thread; the default resource outside scopes.
+    // Memory taken from it must not outlive the scope
+    static std::pmr::memory_resource* GetResource();
+};
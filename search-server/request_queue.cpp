@@ -5,24 +5,18 @@
 
 using namespace std;
 
-RequestQueue::RequestQueue(const SearchServer& search_server)
-    : search_server_(search_server) {
+RequestQueue::RequestQueue(const SearchServer& search_server, QueryLogWriter* query_log)
+    : search_server_(search_server)
+    , query_log_(query_log) {
 }
 
 vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query, DocumentStatus status) {
-    
-    QueryResult request;
-    request.result = search_server_.FindTopDocuments(raw_query);
-    ParseRequest(request);
-    return request.result;
+    return AddFindRequest(raw_query, StatusIs{status});
 }
 
 
 vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query) {
-    QueryResult request;
-    request.result = search_server_.FindTopDocuments(raw_query);
-    ParseRequest(request);
-    return request.result;
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
 }
 
 
@@ -46,3 +40,14 @@ void RequestQueue::ParseRequest(QueryResult& request) {
         --current_time_;
     }
 }
+
+void RequestQueue::LogRequest(string_view raw_query, const QueryFilter& filter,
+                              chrono::steady_clock::time_point start, size_t result_count) {
+    QueryLogRecord record;
+    record.start = chrono::duration_cast<chrono::microseconds>(start - query_log_->GetStartTime());
+    record.latency = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start);
+    record.query = string(raw_query);
+    record.filter = filter;
+    record.result_count = static_cast<uint32_t>(result_count);
+    query_log_->Append(record);
+}
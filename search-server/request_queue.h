@@ -1,16 +1,19 @@
 #pragma once
 
+#include <chrono>
 #include <vector>
 #include <deque>
 #include <string>
 
 #include "search_server.h"
 #include "document.h"
+#include "query_log.h"
 
 
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server);
+    // С query_log каждый запрос записывается в журнал вместе с фильтром и временем выполнения
+    explicit RequestQueue(const SearchServer& search_server, QueryLogWriter* query_log = nullptr);
     // сделаем "обёртки" для всех методов поиска, чтобы сохранять результаты для нашей статистики
     
     template <typename DocumentPredicate>
@@ -35,14 +38,21 @@ private:
     int null_results_ = 0;
     
     const SearchServer& search_server_;
+    QueryLogWriter* const query_log_;
     
     void ParseRequest(QueryResult& request);
+    void LogRequest(std::string_view raw_query, const QueryFilter& filter,
+                    std::chrono::steady_clock::time_point start, size_t result_count);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query, DocumentPredicate document_predicate) {
+    const auto start = std::chrono::steady_clock::now();
     QueryResult request;
-    request.result = search_server_.FindTopDocuments(raw_query);
+    request.result = search_server_.FindTopDocuments(raw_query, document_predicate);
+    if (query_log_ != nullptr) {
+        LogRequest(raw_query, DescribeFilter(document_predicate), start, request.result.size());
+    }
     ParseRequest(request);
     return request.result;
 }
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "document.h"
+
+// Counts of the documents matching a query
+struct SearchFacets {
+    std::array<int, DOCUMENT_STATUS_COUNT> status_counts{};
+    // One more than the rating bounds of the request
+    std::vector<int> rating_counts;
+};
+
+struct FacetedSearchResult {
+    std::vector<Document> documents;
+    SearchFacets facets;
+};
+
+// Bucket i holds the ratings in [bounds[i - 1], bounds[i]); bounds are sorted
+inline size_t GetRatingBucket(const std::vector<int>& bounds, int rating) {
+    return static_cast<size_t>(std::upper_bound(bounds.begin(), bounds.end(), rating) - bounds.begin());
+}
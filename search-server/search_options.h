@@ -0,0 +1,59 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+
+enum class QueryMode {
+    ANY,  // a document must contain at least one plus word
+    ALL,  // a document must contain every plus word
+};
+
+enum class RankingModel {
+    TF_IDF,
+    BM25,
+};
+
+const int QUERY_MODE_COUNT = 2;
+const int RANKING_MODEL_COUNT = 2;
+
+struct Bm25Parameters {
+    double k1 = 1.2;  // term frequency saturation
+    double b = 0.75;  // document length normalization, 0 — none
+};
+
+// Document counts of a collection split over several servers. Scoring a part of the
+// collection with them gives the same IDF as scoring the whole collection
+struct CollectionStatistics {
+    int document_count = 0;
+    // Total length of the documents in non-stop words, for BM25
+    long long word_count = 0;
+    std::map<std::string, int, std::less<>> word_document_counts;
+
+    void Merge(const CollectionStatistics& other) {
+        document_count += other.document_count;
+        word_count += other.word_count;
+        for (const auto& [word, count] : other.word_document_counts) {
+            word_document_counts[word] += count;
+        }
+    }
+};
+
+// Per-query settings of FindTopDocuments/FindLazilySortedDocuments.
+// Quoted phrases ("white cat") are required in any mode
+struct SearchOptions {
+    QueryMode mode = QueryMode::ANY;
+    RankingModel ranking = RankingModel::TF_IDF;
+    Bm25Parameters bm25;
+    // IDF source; nullptr — statistics of the server itself
+    const CollectionStatistics* collection = nullptr;
+    // Weights of the occurrences in named fields (SearchServer::AddDocument with
+    // DocumentField), not negative. Other fields and text outside fields weigh 1
+    std::map<std::string, double, std::less<>> field_weights;
+    // FindTopDocuments searches the impact tier first (SearchServer::EnableImpactTier)
+    // and takes its result when at least min_tier_recall of the top documents are
+    // guaranteed to be those of the full index; otherwise it searches the full index.
+    // 1 — exact results only, 0 — whatever the tier finds
+    bool use_impact_tier = false;
+    double min_tier_recall = 1.0;
+};
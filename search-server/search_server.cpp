@@ -1,40 +1,127 @@
 #include "search_server.h"
+#include "memory_usage.h"
 #include "string_processing.h"
+#include "text_normalization.h"
 
 
 
 using namespace std;
 
-SearchServer::SearchServer(const std::string& stop_words_text)
-   : SearchServer(SplitIntoWords(stop_words_text))  // Invoke delegating constructor from string container
+SearchServer::SearchServer(const std::string& stop_words_text, pmr::memory_resource* resource)
+   : SearchServer(SplitIntoWords(stop_words_text), resource)  // Invoke delegating constructor from string container
        {
        }
 
-SearchServer::SearchServer(std::string_view stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text))
+SearchServer::SearchServer(std::string_view stop_words_text, pmr::memory_resource* resource)
+    : SearchServer(SplitIntoWords(stop_words_text), resource)
        {
        }
 
 
 void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status,
                                const vector<int>& ratings) { 
+    AddDocument(document_id, document, TokenizeDocument(document), status, ratings);
+}
+
+SearchServer::TokenizedDocument SearchServer::TokenizeDocument(string_view document) const {
+    TokenizedDocument result;
+    TokenizeDocument(document, result);
+    return result;
+}
+
+void SearchServer::TokenizeDocument(string_view document, TokenizedDocument& result) const {
+    result.words.clear();
+    result.has_invalid_words = false;
+    result.normalized_text.resize(document.size());
+    if (!NormalizeText(document, result.normalized_text.data())) {
+        result.has_invalid_words = true;
+        return;
+    }
+    const string_view text = result.normalized_text;
+    int position = 0;
+    ForEachWord(text, [&](size_t offset, size_t length) {
+        if (!IsStopWord(text.substr(offset, length))) {
+            result.words.push_back({static_cast<uint32_t>(offset), static_cast<uint32_t>(length), position});
+        }
+        ++position;
+    });
+}
+
+void SearchServer::AddDocument(int document_id, string_view document,
+                               const TokenizedDocument& tokenized_document, DocumentStatus status,
+                               const vector<int>& ratings) {
     if (documents_.count(document_id) > 0) {
         throw invalid_argument ("Документ не был добавлен, так как его id совпадает с уже имеющимся"s);
     }
     if (document_id < 0) {
         throw invalid_argument ("Документ не был добавлен, так как его id отрицательный"s);
     }
-    storage_.emplace_back((std::string(document)));
-    if (auto words = SplitIntoWordsNoStop(storage_.back())) {
-        const double inv_word_count = 1.0 / words->size();
+    if (!tokenized_document.has_invalid_words) {
+        int slot = static_cast<int>(document_attributes_.size());
+        if (!free_slots_.empty()) {
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+        } else {
+            document_attributes_.emplace_back();
+            for (auto& documents : status_documents_) {
+                documents.push_back(false);
+            }
+        }
+        storage_.emplace_back((std::string(document)));
+        const string_view text = storage_.back();
+        const string_view normalized_text = tokenized_document.normalized_text;
+        const double inv_word_count = 1.0 / tokenized_document.words.size();
         
-        for (std::string_view word : *words) {
-            
-            word_to_document_freqs_[word][document_id] += inv_word_count;
-            word_frequencies_[document_id][word] += inv_word_count;
+        //the index keys view the document text where it is already in lower case
+        for (const auto& [offset, length, position] : tokenized_document.words) {
+            const string_view word = normalized_text.substr(offset, length);
+            auto positions = word_to_document_positions_.find(word);
+            if (positions == word_to_document_positions_.end()) {
+                string_view key = text.substr(offset, length);
+                if (key != word) {
+                    key = normalized_words_.emplace_back(word);
+                }
+                positions = word_to_document_positions_.try_emplace(key).first;
+            }
+            positions->second[slot].push_back(position);
         }
-        documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
+        //tf is stored once per word, so a narrow TermFrequency is rounded only once
+        const int word_count = static_cast<int>(tokenized_document.words.size());
+        for (const auto& [offset, length, position] : tokenized_document.words) {
+            const auto& [word, document_positions] =
+                *word_to_document_positions_.find(normalized_text.substr(offset, length));
+            const int term_count = static_cast<int>(document_positions.at(slot).size());
+            const double term_freq = term_count * inv_word_count;
+            if (!word_frequencies_[document_id].emplace(word, term_freq).second) {
+                continue;
+            }
+            const auto [postings, is_new_word] = word_to_document_freqs_.try_emplace(word);
+            if (is_new_word) {
+                term_dictionary_.Insert(postings->first);
+                indexed_words_.push_back(&*postings);
+            }
+            const auto posting = postings->second.emplace(slot, term_freq).first;
+            if (suggestions_) {
+                suggestions_->SetDocumentCount(postings->first, static_cast<int>(postings->second.size()));
+            }
+            if (impact_tier_) {
+                impact_tier_->AddPosting(postings->first, {slot, posting->second, term_count, word_count});
+            }
+
+            TermScoreBound& bound = word_score_bounds_[word];
+            bound.max_term_freq = max(bound.max_term_freq, term_freq);
+            bound.max_term_count = max(bound.max_term_count, term_count);
+            bound.min_document_length = min(bound.min_document_length, word_count);
+        }
+        total_word_count_ += word_count;
+        ++generation_;
+
+        const DocumentData document_data{ComputeAverageRating(ratings), status, word_count, document_id, slot};
+        documents_.emplace(document_id, document_data);
+        document_texts_.emplace(document_id, storage_.back());
         documents_ids_.insert(document_id);
+        document_attributes_[slot] = document_data;
+        status_documents_[static_cast<size_t>(status)][slot] = true;
 
      } else {
          throw invalid_argument ("Документ не был добавлен, так как содержит спецсимволы"s);
@@ -42,30 +129,273 @@ void SearchServer::AddDocument(int document_id, std::string_view document, Docum
 }
 
 
+void SearchServer::AddDocument(int document_id, const vector<DocumentField>& fields, DocumentStatus status,
+                               const vector<int>& ratings) {
+    string document;
+    vector<size_t> field_ends;
+    for (const DocumentField& field : fields) {
+        if (!document.empty()) {
+            document += ' ';
+        }
+        document += field.text;
+        field_ends.push_back(document.size());
+    }
+    TokenizedDocument tokenized_document = TokenizeDocument(document);
+    //a gap of one position at every field boundary keeps phrases inside a field
+    vector<int> word_fields;
+    word_fields.reserve(tokenized_document.words.size());
+    size_t field = 0;
+    for (auto& word : tokenized_document.words) {
+        while (word.offset >= field_ends[field]) {
+            ++field;
+        }
+        word.position += static_cast<int>(field);
+        word_fields.push_back(static_cast<int>(field));
+    }
+    AddDocument(document_id, document, tokenized_document, status, ratings);
+
+    const int slot = documents_.at(document_id).slot;
+    const string_view text = tokenized_document.normalized_text;
+    for (size_t i = 0; i < tokenized_document.words.size(); ++i) {
+        const auto& word = tokenized_document.words[i];
+        const string_view field_name = fields[word_fields[i]].name;
+        auto field_it = field_ids_.find(field_name);
+        if (field_it == field_ids_.end()) {
+            field_it = field_ids_.emplace(field_name, static_cast<int>(field_ids_.size())).first;
+        }
+        //the key of the word, which outlives this document
+        const string_view key = word_to_document_freqs_.find(text.substr(word.offset, word.length))->first;
+        ++word_to_field_counts_[key][field_it->second][slot];
+    }
+}
+
 int SearchServer::GetDocumentCount() const {
     return static_cast<int>(documents_.size());
 }
 
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const {
+IndexStats SearchServer::GetIndexStats() const {
+    IndexStats stats;
+    const auto add_part = [&stats](string name, size_t entries, size_t bytes) {
+        stats.total_bytes += bytes;
+        stats.parts.push_back({move(name), entries, bytes});
+    };
 
+    size_t bytes = GetTreeMemory(stop_words_);
+    for (const string& word : stop_words_) {
+        bytes += GetStringMemory(word);
+    }
+    add_part("stop words"s, stop_words_.size(), bytes);
+
+    bytes = GetDequeMemory(storage_);
+    size_t text_length = 0;
+    for (const auto& text : storage_) {
+        bytes += GetStringMemory(text);
+        text_length += text.size();
+    }
+    add_part("document texts"s, storage_.size(), bytes);
+    for (const auto& [document_id, text] : document_texts_) {
+        text_length -= text.size();
+    }
+    stats.removed_text_bytes = text_length;
+
+    bytes = GetDequeMemory(normalized_words_);
+    for (const auto& word : normalized_words_) {
+        bytes += GetStringMemory(word);
+    }
+    add_part("normalized words"s, normalized_words_.size(), bytes);
+
+    //an empty word still has a node in every map by word and a dictionary entry
+    const size_t empty_term_bytes = GetTreeNodeSize<decltype(word_to_document_freqs_)>()
+        + GetTreeNodeSize<decltype(word_to_document_positions_)>()
+        + GetTreeNodeSize<decltype(word_score_bounds_)>()
+        + sizeof(TermDictionary::Entry) + sizeof(indexed_words_[0]);
+    bytes = GetTreeMemory(word_to_document_freqs_);
+    size_t entries = word_to_document_freqs_.size();
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        bytes += GetTreeMemory(postings);
+        entries += postings.size();
+        if (postings.empty()) {
+            ++stats.empty_term_count;
+            stats.empty_term_bytes += empty_term_bytes + word.size();
+            continue;
+        }
+        ++stats.term_count;
+        stats.posting_count += postings.size();
+        stats.max_posting_length = max(stats.max_posting_length, postings.size());
+        size_t bucket = 0;
+        while ((size_t{2} << bucket) <= postings.size()) {
+            ++bucket;
+        }
+        if (bucket >= stats.posting_length_counts.size()) {
+            stats.posting_length_counts.resize(bucket + 1);
+        }
+        ++stats.posting_length_counts[bucket];
+    }
+    add_part("word postings"s, entries, bytes);
+
+    bytes = GetTreeMemory(word_frequencies_);
+    entries = word_frequencies_.size();
+    for (const auto& [document_id, frequencies] : word_frequencies_) {
+        bytes += GetTreeMemory(frequencies);
+        entries += frequencies.size();
+    }
+    add_part("document words"s, entries, bytes);
+
+    bytes = GetTreeMemory(word_to_document_positions_);
+    entries = word_to_document_positions_.size();
+    for (const auto& [word, document_positions] : word_to_document_positions_) {
+        bytes += GetTreeMemory(document_positions);
+        entries += document_positions.size();
+        for (const auto& [document_id, positions] : document_positions) {
+            bytes += GetVectorMemory(positions);
+        }
+    }
+    add_part("word positions"s, entries, bytes);
+
+    add_part("term dictionary"s, term_dictionary_.GetWordCount(),
+             term_dictionary_.GetMemoryUsage() + GetVectorMemory(indexed_words_));
+    if (suggestions_) {
+        add_part("suggestions"s, word_to_document_freqs_.size(), suggestions_->GetMemoryUsage());
+    }
+    if (impact_tier_) {
+        add_part("impact tier"s, word_to_document_freqs_.size(), impact_tier_->GetMemoryUsage());
+    }
+
+    bytes = GetTreeMemory(field_ids_) + GetTreeMemory(word_to_field_counts_);
+    entries = field_ids_.size() + word_to_field_counts_.size();
+    for (const auto& [name, field_id] : field_ids_) {
+        bytes += GetStringMemory(name);
+    }
+    for (const auto& [word, field_counts] : word_to_field_counts_) {
+        bytes += GetTreeMemory(field_counts);
+        entries += field_counts.size();
+        for (const auto& [field_id, counts] : field_counts) {
+            bytes += GetTreeMemory(counts);
+            entries += counts.size();
+        }
+    }
+    add_part("field counts"s, entries, bytes);
+
+    add_part("score bounds"s, word_score_bounds_.size(), GetTreeMemory(word_score_bounds_));
+    add_part("documents"s, documents_.size(), GetTreeMemory(documents_) + GetTreeMemory(document_texts_));
+
+    bytes = GetVectorMemory(document_attributes_) + GetVectorMemory(status_documents_);
+    for (const auto& documents : status_documents_) {
+        bytes += GetVectorMemory(documents);
+    }
+    add_part("document attributes"s, document_attributes_.size(), bytes);
+    add_part("document ids"s, documents_ids_.size(), GetTreeMemory(documents_ids_));
+
+    stats.document_count = documents_.size();
+    return stats;
+}
+
+CollectionStatistics SearchServer::GetQueryStatistics(string_view raw_query) const {
+    QueryScratch::Scope scratch;
     const auto query = ParseQuery(raw_query);
+    CollectionStatistics statistics;
+    statistics.document_count = GetDocumentCount();
+    statistics.word_count = total_word_count_;
+    for (string_view word : query.plus_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        statistics.word_document_counts.emplace(
+            word, it == word_to_document_freqs_.end() ? 0 : static_cast<int>(it->second.size()));
+    }
+    return statistics;
+}
+
+double SearchServer::GetMaxTermScore(string_view word, const SearchOptions& options) const {
+    const auto it = word_score_bounds_.find(word);
+    if (it == word_score_bounds_.end() || word_to_document_freqs_.at(word).empty()) {
+        return 0.0;
+    }
+    Query query;
+    query.collection = options.collection;
+    query.bm25 = options.bm25;
+    //field weights above 1 can raise the weighted count up to the largest weight
+    double max_weight = 1.0;
+    for (const auto& [name, weight] : options.field_weights) {
+        max_weight = max(max_weight, weight);
+    }
+    TermScoreBound bound = it->second;
+    bound.max_term_freq *= max_weight;
+    bound.max_term_count = static_cast<int>(ceil(bound.max_term_count * max_weight));
+    if (options.ranking == RankingModel::BM25) {
+        return MakeTermScorer<Bm25Scorer>(word, query).GetUpperBound(bound);
+    }
+    return MakeTermScorer<TfIdfScorer>(word, query).GetUpperBound(bound);
+}
+
+void SearchServer::EnableSuggestions(const SuggestionOptions& options) {
+    suggestions_.emplace(options);
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        suggestions_->SetDocumentCount(word, static_cast<int>(postings.size()));
+    }
+}
+
+vector<Suggestion> SearchServer::SuggestCorrections(string_view word, size_t max_count) const {
+    return suggestions_ ? suggestions_->SuggestCorrections(word, max_count) : vector<Suggestion>{};
+}
+
+vector<Suggestion> SearchServer::SuggestCompletions(string_view prefix, size_t max_count) const {
+    return suggestions_ ? suggestions_->SuggestCompletions(prefix, max_count) : vector<Suggestion>{};
+}
+
+void SearchServer::EnableImpactTier(const ImpactTierOptions& options) {
+    impact_tier_.emplace(options, word_to_document_freqs_.get_allocator().resource());
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        const auto& document_positions = word_to_document_positions_.at(word);
+        for (const auto [slot, term_freq] : postings) {
+            impact_tier_->AddPosting(word, {slot, term_freq,
+                                            static_cast<int>(document_positions.at(slot).size()),
+                                            document_attributes_[slot].word_count});
+        }
+    }
+    //prepared queries pick the tier up when they are resolved again
+    ++generation_;
+}
+
+ImpactTierStats SearchServer::GetImpactTierStats() const {
+    return impact_tier_ ? impact_tier_->GetStats() : ImpactTierStats{};
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const {
+    QueryScratch::Scope scratch;
+    return MatchDocument(ParseQuery(raw_query), document_id);
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const PreparedQuery& prepared_query,
+                                                                       int document_id) const {
+    CheckPreparedQuery(prepared_query);
+    return MatchDocument(prepared_query.query_, document_id);
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const Query& query, int document_id) const {
+    const int slot = documents_.at(document_id).slot;
     vector<string_view> matched_words;
 
-        for (string_view word : query.minus_words) {
+    //a document the search would not find matches nothing, whatever the mode
+    if (!HasRequiredWords(query, slot)) {
+        return tie(matched_words, documents_.at(document_id).status);
+    }
+
+    for (string_view word : query.minus_words) {
         if (word_to_document_freqs_.count(word) == 0) {
             continue;
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
+        if (word_to_document_freqs_.at(word).count(slot)) {
             matched_words.clear();
             return tie(matched_words, documents_.at(document_id).status);
         }
     }
-        for (string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    for (string_view word : query.plus_words) {
+        const auto postings = word_to_document_freqs_.find(word);
+        if (postings == word_to_document_freqs_.end()) {
             continue;
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+        //the key outlives the query
+        if (postings->second.count(slot)) {
+            matched_words.push_back(postings->first);
         }
     }
 
@@ -77,49 +407,42 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const {
-    
     if (!documents_ids_.count(document_id)) {
         throw std::out_of_range("Отсутствует документ с указанным ID"s);
     }
+    //one document is too little work to split, and a second implementation drifts
+    //from the modes and phrases of the sequential one
+    return SearchServer::MatchDocument(raw_query, document_id);
+}
 
-    auto query = ParseQuery(raw_query, 1);
-    vector<string_view> matched_words(query.plus_words.size());
-
-    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [&](auto &word){
-        return word_to_document_freqs_.at(word).count(document_id);
-    })) {
-        matched_words.clear();
-        return tie(matched_words, documents_.at(document_id).status);
-    }
-    
-    auto last = std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(),
-        [&](auto &word) {
-            return (word_to_document_freqs_.at(word).count(document_id));
-        });
-    matched_words.erase(last, matched_words.end());
-    std::sort(std::execution::par, matched_words.begin(), matched_words.end());
-    last = std::unique(std::execution::par, matched_words.begin(), matched_words.end());
-    matched_words.erase(last, matched_words.end());
-
-    return tie(matched_words, documents_.at(document_id).status);
- }
-
-set<int>::iterator SearchServer::begin() {
+pmr::set<int>::iterator SearchServer::begin() {
     return documents_ids_.begin();
 }
 
-set<int>::iterator SearchServer::end() {
+pmr::set<int>::iterator SearchServer::end() {
     return documents_ids_.end();
 }
 
-const map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    static std::map<std::string_view, double> empty_map;
+const pmr::map<std::string_view, TermFrequency>& SearchServer::GetWordFrequencies(int document_id) const {
+    static const pmr::map<std::string_view, TermFrequency> empty_map;
     if (word_frequencies_.count(document_id) == 0) {
         return empty_map;
     }
     return word_frequencies_.at(document_id);
 }
 
+string_view SearchServer::GetDocumentText(int document_id) const {
+    return document_texts_.at(document_id);
+}
+
+DocumentStatus SearchServer::GetDocumentStatus(int document_id) const {
+    return documents_.at(document_id).status;
+}
+
+int SearchServer::GetDocumentRating(int document_id) const {
+    return documents_.at(document_id).rating;
+}
+
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
     const auto matched_documents = FindTopDocuments(
         execution::seq, raw_query, DocumentStatus::ACTUAL); 
@@ -132,6 +455,37 @@ vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentS
     return matched_documents;
 }
 
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, const SearchOptions& options) const {
+    return FindTopDocuments(execution::seq, raw_query, options);
+}
+
+vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& prepared_query) const {
+    return FindTopDocuments(execution::seq, prepared_query);
+}
+
+vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& prepared_query, DocumentStatus status) const {
+    return FindTopDocuments(execution::seq, prepared_query, StatusIs{status});
+}
+
+FacetedSearchResult SearchServer::FindTopDocumentsWithFacets(string_view raw_query,
+                                                             const vector<int>& rating_bounds,
+                                                             const SearchOptions& options) const {
+    return FindTopDocumentsWithFacets(execution::seq, raw_query, rating_bounds, options,
+                                      StatusIs{DocumentStatus::ACTUAL});
+}
+
+LazilySortedDocuments SearchServer::FindLazilySortedDocuments(string_view raw_query) const {
+    return FindLazilySortedDocuments(execution::seq, raw_query, DocumentStatus::ACTUAL);
+}
+
+LazilySortedDocuments SearchServer::FindLazilySortedDocuments(string_view raw_query, DocumentStatus status) const {
+    return FindLazilySortedDocuments(execution::seq, raw_query, status);
+}
+
+LazilySortedDocuments SearchServer::FindLazilySortedDocuments(string_view raw_query, const SearchOptions& options) const {
+    return FindLazilySortedDocuments(execution::seq, raw_query, options, StatusIs{DocumentStatus::ACTUAL});
+}
+
 void SearchServer::RemoveDocument(int document_id) {
  //do we have doc on server?
     auto it_to_remove = find(documents_ids_.begin(), documents_ids_.end(), document_id);
@@ -140,13 +494,28 @@ void SearchServer::RemoveDocument(int document_id) {
     }
     //remove from documents_ids_
     documents_ids_.erase(it_to_remove);
+    ++generation_;
 
     //remove from documents
+    const int slot = documents_.at(document_id).slot;
+    status_documents_[static_cast<size_t>(documents_.at(document_id).status)][slot] = false;
+    total_word_count_ -= documents_.at(document_id).word_count;
     documents_.erase(document_id);
+    document_texts_.erase(document_id);
     
     for(auto& [word, freq] : GetWordFrequencies(document_id)) {
-        word_to_document_freqs_[word].erase(document_id);
+        word_to_document_freqs_[word].erase(slot);
+        word_to_document_positions_[word].erase(slot);
+        RemoveFieldCounts(word, slot);
+        if (suggestions_) {
+            suggestions_->SetDocumentCount(word, static_cast<int>(word_to_document_freqs_.at(word).size()));
+        }
+        if (impact_tier_) {
+            impact_tier_->RemovePosting(word, slot);
+        }
     }
+    document_attributes_[slot] = DocumentData{};
+    free_slots_.push_back(slot);
     
     //remove from word_frequencies
     word_frequencies_.erase(document_id);
@@ -165,13 +534,17 @@ void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int do
     }
     //remove from documents_ids_
     documents_ids_.erase(it_to_remove);
+    ++generation_;
 
     //remove from documents
+    const int slot = documents_.at(document_id).slot;
+    status_documents_[static_cast<size_t>(documents_.at(document_id).status)][slot] = false;
+    total_word_count_ -= documents_.at(document_id).word_count;
     documents_.erase(document_id);
+    document_texts_.erase(document_id);
     
-    auto words_to_delete = GetWordFrequencies(document_id);
-    vector<string_view> temp;
-    temp.reserve(words_to_delete.size());
+    const auto& words_to_delete = GetWordFrequencies(document_id);
+    vector<string_view> temp(words_to_delete.size());
     
     transform(words_to_delete.begin(), words_to_delete.end(), temp.begin(), 
     [](auto& word) {
@@ -179,9 +552,23 @@ void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int do
     });
 
     for_each(execution::par, temp.begin(),temp.end(), 
-    [this, &document_id](auto word){
-        word_to_document_freqs_[word].erase(document_id);
+    [this, slot](auto word){
+        word_to_document_freqs_.at(word).erase(slot);
+        word_to_document_positions_.at(word).erase(slot);
+        RemoveFieldCounts(word, slot);
     });
+    if (suggestions_) {
+        for (string_view word : temp) {
+            suggestions_->SetDocumentCount(word, static_cast<int>(word_to_document_freqs_.at(word).size()));
+        }
+    }
+    if (impact_tier_) {
+        for (string_view word : temp) {
+            impact_tier_->RemovePosting(word, slot);
+        }
+    }
+    document_attributes_[slot] = DocumentData{};
+    free_slots_.push_back(slot);
 
     
     //remove from word_frequencies
@@ -197,21 +584,20 @@ bool SearchServer::IsValidWord(std::string_view word) {
         });
     }
 
-bool SearchServer::IsStopWord(std::string_view word) const {
-    return stop_words_.count(word) > 0;
-}
-
-optional<vector<string_view>> SearchServer::SplitIntoWordsNoStop(std::string_view text) const {
-     vector<string_view> words;
-    for (string_view word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            return nullopt;
-        }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+set<string, less<>> SearchServer::NormalizeStopWords(const set<string, less<>>& stop_words) {
+    set<string, less<>> result;
+    for (const string& word : stop_words) {
+        string normalized(word.size(), '\0');
+        if (!NormalizeText(word, normalized.data())) {
+            throw invalid_argument("Недопустимые символы во множестве стоп-слов"s);
         }
+        result.insert(move(normalized));
     }
-    return words;
+    return result;
+}
+
+bool SearchServer::IsStopWord(std::string_view word) const {
+    return stop_words_.count(word) > 0;
 }
 
 int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
@@ -229,44 +615,439 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
         is_minus = true;
         text = text.substr(1);
     }
-    if (!IsValidWord(text)) {
-        throw invalid_argument ("В поисковом запросе \""s + std::string(text) + "\" есть недопустимые символы с кодами от 0 до 31"s);
-    }
     if (text.size() == 0) {
         throw invalid_argument ("Отсутствие текста после символа «минус» в поисковом запросе"s);
     }
     if (text[0] == '-') {
         throw invalid_argument ("Наличие более чем одного минуса перед словами, которых не должно быть в искомых документах"s);
     }
-    QueryWord query_word = {text, is_minus, IsStopWord(text)};
+    bool is_prefix = false;
+    int max_edits = 0;
+    const size_t tilde = text.rfind('~');
+    if (text.back() == '*') {
+        is_prefix = true;
+        text.remove_suffix(1);
+    } else if (tilde != string_view::npos
+               && (tilde + 1 == text.size() || (tilde + 2 == text.size() && text.back() >= '0' && text.back() <= '9'))) {
+        const string_view edits = text.substr(tilde + 1);
+        if (edits.empty()) {
+            max_edits = 1;
+        } else if (edits == "1"sv || edits == "2"sv) {
+            max_edits = edits[0] - '0';
+        } else {
+            throw invalid_argument ("Допустимое число правок после «~» в поисковом запросе — 1 или 2"s);
+        }
+        text = text.substr(0, tilde);
+    }
+    if ((is_prefix || max_edits > 0) && text.empty()) {
+        throw invalid_argument ("Отсутствие текста перед «*» или «~» в поисковом запросе"s);
+    }
+    QueryWord query_word = {text, is_minus, !is_prefix && max_edits == 0 && IsStopWord(text),
+                            is_prefix, max_edits};
     return  query_word;
 }
 
-SearchServer::Query SearchServer::ParseQuery(std::string_view text, bool par) const {
-    Query query;
-    
-        for (std::string_view word : SplitIntoWords(text)) {
-            const QueryWord query_word = ParseQueryWord(word);
-            if (!query_word.is_stop) {
-                if (query_word.is_minus) {
-                        query.minus_words.push_back(query_word.data);
-                } else {
-                        query.plus_words.push_back(query_word.data);
+SearchServer::Query SearchServer::ParseQuery(std::string_view text, QueryMode mode,
+                                             pmr::memory_resource* resource) const {
+    Query query(resource);
+    query.normalized_text.resize(text.size());
+    if (!NormalizeText(text, query.normalized_text.data())) {
+        throw invalid_argument ("В поисковом запросе \""s + std::string(text)
+                                + "\" есть недопустимые символы с кодами от 0 до 31 или нарушена кодировка UTF-8"s);
+    }
+    bool in_phrase = false;
+    int position = 0;
+    int phrase_start = 0;
+
+    auto add_word = [&](const QueryWord& query_word) {
+        if (in_phrase && query_word.is_minus) {
+            throw invalid_argument ("Минус-слово внутри фразы в кавычках"s);
+        }
+        if ((query_word.is_prefix || query_word.max_edits > 0) && in_phrase) {
+            throw invalid_argument ("Слово с «*» или «~» внутри фразы в кавычках"s);
+        }
+        if (query_word.is_prefix || query_word.max_edits > 0) {
+            auto& words = query_word.is_minus ? query.minus_words : query.plus_words;
+            const size_t first_expansion = words.size();
+            ExpandQueryWord(query_word, words);
+            query.has_expansions = true;
+            if (mode == QueryMode::ALL && !query_word.is_minus) {
+                query.required_expansions.emplace_back(words.begin() + first_expansion, words.end());
+            }
+        } else if (!query_word.is_stop) {
+            if (query_word.is_minus) {
+                    query.minus_words.push_back(query_word.data);
+            } else {
+                    query.plus_words.push_back(query_word.data);
+                    if (mode == QueryMode::ALL) {
+                        query.required_words.push_back(query_word.data);
+                    }
+            }
+            if (in_phrase) {
+                query.phrases.back().words.push_back(query_word.data);
+                query.phrases.back().offsets.push_back(position - phrase_start);
+            }
+        }
+        ++position;
+    };
+
+        pmr::vector<string_view> words(QueryScratch::GetResource());
+        pmr::vector<pair<size_t, size_t>> word_spans(QueryScratch::GetResource());
+        SplitIntoWords(string_view(query.normalized_text.data(), query.normalized_text.size()), words);
+        for (std::string_view word : words) {
+            if (!in_phrase && word[0] == '"') {
+                word.remove_prefix(1);
+                in_phrase = true;
+                phrase_start = position;
+                query.phrases.emplace_back();
+            }
+            const bool closes_phrase = in_phrase && !word.empty() && word.back() == '"';
+            if (closes_phrase) {
+                word.remove_suffix(1);
+            }
+            if (!word.empty()) {
+                const QueryWord query_word = ParseQueryWord(word);
+                //punctuation splits the word as it does in documents; «*» and «~» apply to the last part
+                word_spans.clear();
+                ForEachWord(query_word.data, [&word_spans](size_t offset, size_t length) {
+                    word_spans.emplace_back(offset, length);
+                });
+                for (size_t i = 0; i < word_spans.size(); ++i) {
+                    QueryWord part = query_word;
+                    part.data = query_word.data.substr(word_spans[i].first, word_spans[i].second);
+                    if (i + 1 < word_spans.size()) {
+                        part.is_prefix = false;
+                        part.max_edits = 0;
+                    }
+                    part.is_stop = !part.is_prefix && part.max_edits == 0 && IsStopWord(part.data);
+                    add_word(part);
                 }
             }
+            if (closes_phrase) {
+                in_phrase = false;
+            }
         }
-     if (!par) {   
-            std::sort(query.minus_words.begin(), query.minus_words.end());
-            auto last = std::unique(query.minus_words.begin(), query.minus_words.end());
-            query.minus_words.erase(last, query.minus_words.end()); 
+    if (in_phrase) {
+        throw invalid_argument ("Отсутствует закрывающая кавычка в поисковом запросе"s);
+    }
+    query.phrases.erase(remove_if(query.phrases.begin(), query.phrases.end(), [](const Phrase& phrase) {
+        return phrase.words.empty();
+    }), query.phrases.end());
+
+    for (const Phrase& phrase : query.phrases) {
+        query.required_words.insert(query.required_words.end(), phrase.words.begin(), phrase.words.end());
+    }
+    std::sort(query.required_words.begin(), query.required_words.end());
+    query.required_words.erase(std::unique(query.required_words.begin(), query.required_words.end()),
+                               query.required_words.end());
+    std::sort(query.minus_words.begin(), query.minus_words.end());
+    auto last = std::unique(query.minus_words.begin(), query.minus_words.end());
+    query.minus_words.erase(last, query.minus_words.end());
 
-            std::sort(query.plus_words.begin(), query.plus_words.end());
-            last = std::unique(query.plus_words.begin(), query.plus_words.end());
-            query.plus_words.erase(last, query.plus_words.end());
-    } 
+    std::sort(query.plus_words.begin(), query.plus_words.end());
+    last = std::unique(query.plus_words.begin(), query.plus_words.end());
+    query.plus_words.erase(last, query.plus_words.end());
     return query;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+void SearchServer::ExpandQueryWord(const QueryWord& query_word, pmr::vector<string_view>& words) const {
+    pmr::vector<TermDictionary::Match> matches(QueryScratch::GetResource());
+    if (query_word.is_prefix) {
+        term_dictionary_.FindByPrefix(query_word.data, matches);
+    } else {
+        term_dictionary_.FindWithinDistance(query_word.data, query_word.max_edits, matches);
+    }
+    //words of removed documents stay in the dictionary without documents
+    pmr::vector<TermExpansion> expansions(QueryScratch::GetResource());
+    for (const auto [word_id, edits] : matches) {
+        const auto& [word, postings] = *indexed_words_[word_id];
+        if (!postings.empty()) {
+            expansions.push_back({word, edits, static_cast<int>(postings.size())});
+        }
+    }
+    const auto middle = expansions.begin()
+        + min(expansions.size(), static_cast<size_t>(MAX_QUERY_TERM_EXPANSIONS));
+    partial_sort(expansions.begin(), middle, expansions.end(),
+        [](const TermExpansion& lhs, const TermExpansion& rhs) {
+            return tie(lhs.edits, rhs.document_count, lhs.word)
+                 < tie(rhs.edits, lhs.document_count, rhs.word);
+        });
+    for (auto it = expansions.begin(); it != middle; ++it) {
+        words.push_back(it->word);
+    }
+}
+
+SearchServer::Query SearchServer::ParseQuery(string_view text, const SearchOptions& options,
+                                             pmr::memory_resource* resource) const {
+    Query query = ParseQuery(text, options.mode, resource);
+    for (const auto& [name, weight] : options.field_weights) {
+        if (!(weight >= 0.0)) {
+            throw invalid_argument ("Вес поля \""s + name + "\" должен быть неотрицательным"s);
+        }
+        //no document has a field the server has not seen
+        const auto it = field_ids_.find(string_view(name));
+        if (it != field_ids_.end() && weight != 1.0) {
+            query.field_weight_deltas.push_back({it->second, weight - 1.0});
+        }
+    }
+    if (!(options.min_tier_recall >= 0.0 && options.min_tier_recall <= 1.0)) {
+        throw invalid_argument ("Доля гарантированных документов первого уровня должна быть от 0 до 1"s);
+    }
+    query.collection = options.collection;
+    query.ranking = options.ranking;
+    query.bm25 = options.bm25;
+    query.use_impact_tier = options.use_impact_tier;
+    query.min_tier_recall = options.min_tier_recall;
+    ResolveTerms(query);
+    return query;
+}
+
+void SearchServer::ResolveTerms(Query& query) const {
+    query.plus_terms.clear();
+    query.minus_postings.clear();
+    for (string_view word : query.plus_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end() || it->second.empty()) {
+            continue;
+        }
+        const auto field_it = query.field_weight_deltas.empty()
+            ? word_to_field_counts_.end() : word_to_field_counts_.find(word);
+        const double inverse_document_freq = query.ranking == RankingModel::BM25
+            ? ComputeBm25InverseDocumentFreq(word, query.collection)
+            : ComputeWordInverseDocumentFreq(word, query.collection);
+        query.plus_terms.push_back({it->first, &it->second,
+                                    field_it == word_to_field_counts_.end() ? nullptr : &field_it->second,
+                                    inverse_document_freq,
+                                    query.use_impact_tier && impact_tier_ ? impact_tier_->Find(word) : nullptr});
+    }
+    for (string_view word : query.minus_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end() && !it->second.empty()) {
+            query.minus_postings.push_back(&it->second);
+        }
+    }
+    query.average_document_length = GetAverageDocumentLength(query.collection);
+    query.generation = generation_;
+}
+
+SearchServer::Query SearchServer::CopyWithCurrentTerms(const Query& query) const {
+    Query current(query, QueryScratch::GetResource());
+    ResolveTerms(current);
+    return current;
+}
+
+void SearchServer::CheckPreparedQuery(const PreparedQuery& prepared_query) const {
+    if (prepared_query.server_ != this) {
+        throw invalid_argument ("Запрос подготовлен для другого поискового сервера"s);
+    }
+}
+
+SearchServer::PreparedQuery SearchServer::PrepareQuery(string_view raw_query, const SearchOptions& options) const {
+    //the query owns its memory, it outlives any scope
+    return PreparedQuery(this, string(raw_query), options,
+                         ParseQuery(raw_query, options, pmr::get_default_resource()));
+}
+
+void SearchServer::RefreshQuery(PreparedQuery& prepared_query) const {
+    CheckPreparedQuery(prepared_query);
+    if (prepared_query.query_.has_expansions) {
+        prepared_query.query_ = ParseQuery(prepared_query.text_, prepared_query.options_,
+                                           pmr::get_default_resource());
+    } else {
+        ResolveTerms(prepared_query.query_);
+    }
+}
+
+pair<int, int> SearchServer::GetWordDocumentCounts(string_view word,
+                                                   const CollectionStatistics* collection) const {
+    if (collection != nullptr) {
+        const auto it = collection->word_document_counts.find(word);
+        if (it != collection->word_document_counts.end() && it->second > 0) {
+            return {collection->document_count, it->second};
+        }
+    }
+    return {GetDocumentCount(), static_cast<int>(word_to_document_freqs_.at(word).size())};
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word,
+                                                    const CollectionStatistics* collection) const {
+    const auto [document_count, word_document_count] = GetWordDocumentCounts(word, collection);
+    return log(document_count * 1.0 / word_document_count);
+}
+
+double SearchServer::ComputeBm25InverseDocumentFreq(string_view word,
+                                                    const CollectionStatistics* collection) const {
+    const auto [document_count, word_document_count] = GetWordDocumentCounts(word, collection);
+    return log(1.0 + (document_count - word_document_count + 0.5) / (word_document_count + 0.5));
+}
+
+double SearchServer::GetAverageDocumentLength(const CollectionStatistics* collection) const {
+    if (collection != nullptr && collection->document_count > 0) {
+        return collection->word_count * 1.0 / collection->document_count;
+    }
+    return documents_.empty() ? 0.0 : total_word_count_ * 1.0 / documents_.size();
+}
+
+double SearchServer::WeighTermFreq(double term_freq, int slot, const FieldTermCounts* field_counts,
+                                   const Query& query) const {
+    if (field_counts == nullptr) {
+        return term_freq;
+    }
+    double weighted_count = 0.0;
+    for (const auto& [field_id, weight_delta] : query.field_weight_deltas) {
+        const auto field_it = field_counts->find(field_id);
+        if (field_it != field_counts->end()) {
+            const auto it = field_it->second.find(slot);
+            if (it != field_it->second.end()) {
+                weighted_count += weight_delta * it->second;
+            }
+        }
+    }
+    return term_freq + weighted_count / document_attributes_[slot].word_count;
+}
+
+void SearchServer::RemoveFieldCounts(string_view word, int slot) {
+    const auto it = word_to_field_counts_.find(word);
+    if (it != word_to_field_counts_.end()) {
+        for (auto& [field_id, counts] : it->second) {
+            counts.erase(slot);
+        }
+    }
+}
+
+SearchServer::DenseRelevance& SearchServer::GetThreadRelevance() {
+    thread_local DenseRelevance relevance;
+    return relevance;
+}
+
+void SearchServer::DenseRelevance::Prepare(size_t slot_count) {
+    for (const int slot : slots) {
+        relevance[slot] = 0;
+        is_matched[slot] = false;
+    }
+    slots.clear();
+    if (relevance.size() < slot_count) {
+        relevance.resize(slot_count);
+        is_matched.resize(slot_count);
+    }
+}
+
+bool SearchServer::HasAnyWord(const pmr::vector<string_view>& words, int slot) const {
+    return any_of(words.begin(), words.end(), [this, slot](string_view word) {
+        const auto it = word_to_document_freqs_.find(word);
+        return it != word_to_document_freqs_.end() && it->second.count(slot) > 0;
+    });
+}
+
+bool SearchServer::HasPhrase(const Phrase& phrase, int slot) const {
+    //called for every candidate, possibly from several threads
+    thread_local vector<const pmr::vector<int>*> positions;
+    positions.clear();
+    for (string_view word : phrase.words) {
+        const auto word_it = word_to_document_positions_.find(word);
+        if (word_it == word_to_document_positions_.end()) {
+            return false;
+        }
+        const auto document_it = word_it->second.find(slot);
+        if (document_it == word_it->second.end()) {
+            return false;
+        }
+        positions.push_back(&document_it->second);
+    }
+    return any_of(positions[0]->begin(), positions[0]->end(), [&](int start) {
+        for (size_t i = 1; i < positions.size(); ++i) {
+            if (!binary_search(positions[i]->begin(), positions[i]->end(),
+                               start - phrase.offsets[0] + phrase.offsets[i])) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+bool SearchServer::HasRequiredExpansionsAndPhrases(const Query& query, int slot) const {
+    return all_of(query.required_expansions.begin(), query.required_expansions.end(),
+               [&](const pmr::vector<string_view>& words) {
+                   return HasAnyWord(words, slot);
+               })
+        && all_of(query.phrases.begin(), query.phrases.end(), [&](const Phrase& phrase) {
+               return HasPhrase(phrase, slot);
+           });
+}
+
+bool SearchServer::HasRequiredWords(const Query& query, int slot) const {
+    return all_of(query.required_words.begin(), query.required_words.end(), [&](string_view word) {
+               const auto it = word_to_document_freqs_.find(word);
+               return it != word_to_document_freqs_.end() && it->second.count(slot) > 0;
+           })
+        && HasRequiredExpansionsAndPhrases(query, slot);
+}
+
+pmr::vector<int> SearchServer::IntersectRequiredWords(const Query& query) const {
+    pmr::memory_resource* resource = QueryScratch::GetResource();
+    pmr::vector<const pmr::map<int, TermFrequency>*> postings(resource);
+    for (string_view word : query.required_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end() || it->second.empty()) {
+            return pmr::vector<int>(resource);
+        }
+        postings.push_back(&it->second);
+    }
+    //start from the rarest word, the other lists are only probed
+    sort(postings.begin(), postings.end(), [](const auto* lhs, const auto* rhs) {
+        return lhs->size() < rhs->size();
+    });
+
+    pmr::vector<pmr::map<int, TermFrequency>::const_iterator> cursors(resource);
+    for (const auto* list : postings) {
+        cursors.push_back(list->begin());
+    }
+
+    pmr::vector<int> documents(resource);
+    if (postings.empty()) {
+        //only expanded words are required: start from the union of the smallest expansion
+        const auto postings_size = [this](const pmr::vector<string_view>& words) {
+            size_t size = 0;
+            for (string_view word : words) {
+                size += word_to_document_freqs_.at(word).size();
+            }
+            return size;
+        };
+        const auto& rarest = *min_element(query.required_expansions.begin(), query.required_expansions.end(),
+            [&](const auto& lhs, const auto& rhs) {
+                return postings_size(lhs) < postings_size(rhs);
+            });
+        for (string_view word : rarest) {
+            for (const auto [slot, _] : word_to_document_freqs_.at(word)) {
+                documents.push_back(slot);
+            }
+        }
+        sort(documents.begin(), documents.end());
+        documents.erase(unique(documents.begin(), documents.end()), documents.end());
+        documents.erase(remove_if(documents.begin(), documents.end(), [&](int slot) {
+            return !HasRequiredExpansionsAndPhrases(query, slot);
+        }), documents.end());
+        return documents;
+    }
+    for (const auto [slot, _] : *postings[0]) {
+        bool in_all = true;
+        for (size_t i = 1; i < postings.size(); ++i) {
+            auto& cursor = cursors[i];
+            if (cursor != postings[i]->end() && cursor->first < slot) {
+                //skip ahead instead of stepping through the longer list
+                cursor = postings[i]->lower_bound(slot);
+            }
+            if (cursor == postings[i]->end()) {
+                return documents;
+            }
+            if (cursor->first != slot) {
+                in_all = false;
+                break;
+            }
+        }
+        if (in_all && HasRequiredExpansionsAndPhrases(query, slot)) {
+            documents.push_back(slot);
+        }
+    }
+    return documents;
 }
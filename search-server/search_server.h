@@ -13,12 +13,28 @@
 #include <execution>
 #include <functional>
 #include <deque>
+#include <memory_resource>
+#include <array>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
 
 #include <optional>
 
 #include "document.h"
+#include "document_predicates.h"
+#include "impact_tier.h"
+#include "index_stats.h"
+#include "lazily_sorted_documents.h"
+#include "query_scratch.h"
 #include "read_input_functions.h"
+#include "search_facets.h"
+#include "search_options.h"
 #include "string_processing.h"
+#include "suggestion_index.h"
+#include "term_dictionary.h"
+#include "term_frequency.h"
+#include "term_scorers.h"
 
 #include "concurrent_map.h"
 
@@ -27,19 +43,64 @@
 using namespace std::string_literals;
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
+//dictionary words a term* or term~ query word expands to at most
+const int MAX_QUERY_TERM_EXPANSIONS = 50;
 
 class SearchServer {
 public:
     
+    // The index is allocated from resource, which must outlive the server.
+    // RemoveDocument(par) frees memory from several threads, so the resource has to be
+    // synchronized if it is used
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
-    explicit SearchServer(const std::string& stop_words_text);
-    explicit SearchServer(std::string_view stop_words_text);
+    explicit SearchServer(const StringContainer& stop_words,
+                          std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    explicit SearchServer(const std::string& stop_words_text,
+                          std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    explicit SearchServer(std::string_view stop_words_text,
+                          std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
     void AddDocument(int document_id, std::string_view document, DocumentStatus status,
                      const std::vector<int>& ratings);
+
+    // Non-stop words of a document as offsets into its text. Tokenizing does not touch
+    // the index, so loaders run it on their own threads and pass the result to AddDocument
+    struct TokenizedDocument {
+        struct Word {
+            uint32_t offset;
+            uint32_t length;
+            int position;
+        };
+        std::vector<Word> words;
+        // The text in lower case, of the same length; words are read from it
+        std::string normalized_text;
+        bool has_invalid_words = false;
+    };
+
+    TokenizedDocument TokenizeDocument(std::string_view document) const;
+    // Reuses the memory of result
+    void TokenizeDocument(std::string_view document, TokenizedDocument& result) const;
+
+    // tokenized_document must be made from document
+    void AddDocument(int document_id, std::string_view document,
+                     const TokenizedDocument& tokenized_document, DocumentStatus status,
+                     const std::vector<int>& ratings);
+
+    // The text of the document is the fields joined by spaces; a phrase does not run
+    // across fields. Word counts are also kept per field, for SearchOptions::field_weights
+    void AddDocument(int document_id, const std::vector<DocumentField>& fields, DocumentStatus status,
+                     const std::vector<int>& ratings);
     
     //FindTopDocuments with policy
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+                                           const SearchOptions& options,
+                                           DocumentPredicate document_predicate) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+                                           const SearchOptions& options) const;
+
     template <typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
                                            DocumentPredicate document_predicate) const;
@@ -58,20 +119,122 @@ public:
                                            DocumentPredicate document_predicate) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const SearchOptions& options) const;
+
+    //FindTopDocumentsWithFacets: the top documents accepted by the predicate, and the counts
+    //of all documents matching the query, whatever the predicate, by status and rating bucket.
+    //Rating bucket i is [rating_bounds[i - 1], rating_bounds[i]), the first and the last are open
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    FacetedSearchResult FindTopDocumentsWithFacets(const ExecutionPolicy& policy, std::string_view raw_query,
+                                                   const std::vector<int>& rating_bounds,
+                                                   const SearchOptions& options,
+                                                   DocumentPredicate document_predicate) const;
+
+    template <typename DocumentPredicate>
+    FacetedSearchResult FindTopDocumentsWithFacets(std::string_view raw_query,
+                                                   const std::vector<int>& rating_bounds,
+                                                   const SearchOptions& options,
+                                                   DocumentPredicate document_predicate) const;
+    FacetedSearchResult FindTopDocumentsWithFacets(std::string_view raw_query,
+                                                   const std::vector<int>& rating_bounds,
+                                                   const SearchOptions& options = {}) const;
+
+    //FindLazilySortedDocuments: all matched documents without MAX_RESULT_DOCUMENT_COUNT limit.
+    //Every match is scored up front, as in FindTopDocuments; only sorting is deferred to the
+    //pages that are requested, so an early page saves the full sort but not the scoring
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    LazilySortedDocuments FindLazilySortedDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+                                                    const SearchOptions& options,
+                                                    DocumentPredicate document_predicate) const;
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    LazilySortedDocuments FindLazilySortedDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+                                                    DocumentPredicate document_predicate) const;
+
+    template <typename ExecutionPolicy>
+    LazilySortedDocuments FindLazilySortedDocuments(
+        const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status) const;
+
+    template <typename ExecutionPolicy>
+    LazilySortedDocuments FindLazilySortedDocuments(
+        const ExecutionPolicy& policy, std::string_view raw_query) const;
+
+    template <typename DocumentPredicate>
+    LazilySortedDocuments FindLazilySortedDocuments(std::string_view raw_query,
+                                                    DocumentPredicate document_predicate) const;
+    LazilySortedDocuments FindLazilySortedDocuments(std::string_view raw_query) const;
+    LazilySortedDocuments FindLazilySortedDocuments(std::string_view raw_query, DocumentStatus status) const;
+    LazilySortedDocuments FindLazilySortedDocuments(std::string_view raw_query, const SearchOptions& options) const;
 
     int GetDocumentCount() const;
 
+    // Estimated memory of every part of the index and the shape of the posting lists,
+    // for sizing hosts and deciding when to rebuild the index. Walks the whole index
+    IndexStats GetIndexStats() const;
+
+    // Document count and document frequencies of the query plus words,
+    // to be merged with other servers into SearchOptions::collection
+    CollectionStatistics GetQueryStatistics(std::string_view raw_query) const;
+
+    // The largest contribution the word can give to the relevance of a document under
+    // the ranking model of options, for early termination; 0 for an unknown word
+    double GetMaxTermScore(std::string_view word, const SearchOptions& options = {}) const;
+
+    // Builds the corrections and completions index from the vocabulary, after which
+    // AddDocument and RemoveDocument keep it up to date
+    void EnableSuggestions(const SuggestionOptions& options = {});
+    // Indexed words close to a misspelled word and indexed words starting with
+    // a partial one, normalized as queries are; empty until EnableSuggestions
+    std::vector<Suggestion> SuggestCorrections(std::string_view word, size_t max_count = 5) const;
+    std::vector<Suggestion> SuggestCompletions(std::string_view prefix, size_t max_count = 5) const;
+
+    // Builds the impact tier from the index, after which AddDocument and RemoveDocument
+    // keep it up to date. Only FindTopDocuments with SearchOptions::use_impact_tier
+    // reads it; a query with required words or field weights still runs on the full index
+    void EnableImpactTier(const ImpactTierOptions& options = {});
+    // Zero until EnableImpactTier
+    ImpactTierStats GetImpactTierStats() const;
+
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
         std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
         const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
         const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const;
+
+    // A query parsed and resolved against the index once, for repeated execution, defined below
+    class PreparedQuery;
+
+    // Throws std::invalid_argument for an invalid query, as FindTopDocuments does
+    PreparedQuery PrepareQuery(std::string_view raw_query, const SearchOptions& options = {}) const;
+    // Resolves the words against the current index, expanding term* and term~ again
+    void RefreshQuery(PreparedQuery& prepared_query) const;
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery& prepared_query,
+                                           DocumentPredicate document_predicate) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery& prepared_query) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const PreparedQuery& prepared_query,
+                                           DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(const PreparedQuery& prepared_query) const;
+    std::vector<Document> FindTopDocuments(const PreparedQuery& prepared_query, DocumentStatus status) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+        const PreparedQuery& prepared_query, int document_id) const;
     
-    std::set<int>::iterator begin();
-    std::set<int>::iterator end();
+    // std::pmr types, not std::set<int>::iterator and std::map<std::string_view, double>:
+    // the index is allocated from the memory_resource of the server
+    std::pmr::set<int>::iterator begin();
+    std::pmr::set<int>::iterator end();
     
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    const std::pmr::map<std::string_view, TermFrequency>& GetWordFrequencies(int document_id) const;
+
+    // Stored document attributes; throw std::out_of_range for an unknown id
+    std::string_view GetDocumentText(int document_id) const;
+    DocumentStatus GetDocumentStatus(int document_id) const;
+    int GetDocumentRating(int document_id) const;
     
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
@@ -81,66 +244,366 @@ private:
     struct DocumentData {
         int rating;
         DocumentStatus status;
+        //non-stop words, the document length for BM25
+        int word_count = 0;
+        int id = -1;
+        //index into the tables read by the posting loops, reused after removal
+        int slot = -1;
     };
 
 
     const std::set<std::string, std::less<>> stop_words_;
-    std::deque<std::string> storage_;
+    std::pmr::deque<std::pmr::string> storage_;
+    //words whose normalized form differs from the text they first occurred in
+    std::pmr::deque<std::pmr::string> normalized_words_;
 
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
+    //word to document slot to term frequency. The index below is keyed by slot rather
+    //than by id, so its tables grow with the document count whatever the ids are
+    std::pmr::map<std::string_view, std::pmr::map<int, TermFrequency>> word_to_document_freqs_;
     
     //doc_id to word/freq
-    std::map<int, std::map<std::string_view, double>> word_frequencies_;
+    std::pmr::map<int, std::pmr::map<std::string_view, TermFrequency>> word_frequencies_;
     
-    std::map<int, DocumentData> documents_;
+    //word to slot to word positions in the document text, for phrase queries
+    std::pmr::map<std::string_view, std::pmr::map<int, std::pmr::vector<int>>> word_to_document_positions_;
+
+    //keys of word_to_document_freqs_, for term* and term~ query words
+    TermDictionary term_dictionary_;
+    //word id of term_dictionary_ to its entry in word_to_document_freqs_
+    std::pmr::vector<const std::pair<const std::string_view, std::pmr::map<int, TermFrequency>>*> indexed_words_;
+
+    std::optional<SuggestionIndex> suggestions_;
+    std::optional<ImpactTierIndex> impact_tier_;
+
+    //field id to slot to occurrences of a word in the field
+    using FieldTermCounts = std::pmr::map<int, std::pmr::map<int, int>>;
+    std::pmr::map<std::pmr::string, int, std::less<>> field_ids_;
+    //only the words of documents with fields, so the size follows the field contents
+    std::pmr::map<std::string_view, FieldTermCounts> word_to_field_counts_;
+
+    std::pmr::map<std::string_view, TermScoreBound> word_score_bounds_;
+    long long total_word_count_ = 0;
+
+    std::pmr::map<int, DocumentData> documents_;
+    std::pmr::map<int, std::string_view> document_texts_;
+
+    //flat copies of documents_ indexed by slot, read in the posting loops; a free slot has id -1
+    std::pmr::vector<DocumentData> document_attributes_;
+    //DOCUMENT_STATUS_COUNT bitmaps by slot
+    std::pmr::vector<std::pmr::vector<bool>> status_documents_;
+    std::pmr::vector<int> free_slots_;
     
-    std::set<int> documents_ids_;
+    std::pmr::set<int> documents_ids_;
+
+    //changes with every added or removed document; a query resolved at another
+    //generation is resolved again before it runs
+    uint64_t generation_ = 0;
 
     static bool IsValidWord(std::string_view word);
+    static std::set<std::string, std::less<>> NormalizeStopWords(const std::set<std::string, std::less<>>& stop_words);
     
     bool IsStopWord(std::string_view word) const;
 
-    std::optional<std::vector<std::string_view>> SplitIntoWordsNoStop(std::string_view text) const;
-
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        //term* matches the words starting with data, term~ and term~2 the words
+        //within 1 or 2 edits of data
+        bool is_prefix = false;
+        int max_edits = 0;
     };
 
     QueryWord ParseQueryWord(std::string_view text) const;
 
+    struct TermExpansion {
+        std::string_view word;
+        int edits;
+        int document_count;
+    };
+
+    // Appends the dictionary words matching a term* or term~ query word, the closest
+    // and then the most frequent ones first
+    void ExpandQueryWord(const QueryWord& query_word, std::pmr::vector<std::string_view>& words) const;
+
+    //query temporaries live in QueryScratch; Phrase is allocator-aware so that
+    //Query::phrases passes the arena down to it
+    struct Phrase {
+        using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+        explicit Phrase(const allocator_type& allocator = {})
+            : words(allocator)
+            , offsets(allocator) {
+        }
+        Phrase(const Phrase& other, const allocator_type& allocator)
+            : words(other.words, allocator)
+            , offsets(other.offsets, allocator) {
+        }
+        Phrase(Phrase&& other, const allocator_type& allocator)
+            : words(std::move(other.words), allocator)
+            , offsets(std::move(other.offsets), allocator) {
+        }
+        Phrase(const Phrase&) = default;
+        Phrase(Phrase&&) = default;
+        Phrase& operator=(const Phrase&) = default;
+        Phrase& operator=(Phrase&&) = default;
+
+        std::pmr::vector<std::string_view> words;
+        //word positions relative to the first word of the phrase, stop words included
+        std::pmr::vector<int> offsets;
+    };
+
     struct Query {
-            std::vector<std::string_view> plus_words;
-            std::vector<std::string_view> minus_words;
+            explicit Query(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+                : normalized_text(resource)
+                , plus_words(resource)
+                , minus_words(resource)
+                , phrases(resource)
+                , required_words(resource)
+                , required_expansions(resource)
+                , field_weight_deltas(resource)
+                , plus_terms(resource)
+                , minus_postings(resource) {
+            }
+            //a copy in resource; its words keep viewing the text of other
+            Query(const Query& other, std::pmr::memory_resource* resource)
+                : normalized_text(resource)
+                , plus_words(other.plus_words, resource)
+                , minus_words(other.minus_words, resource)
+                , phrases(other.phrases, resource)
+                , required_words(other.required_words, resource)
+                , required_expansions(other.required_expansions, resource)
+                , field_weight_deltas(other.field_weight_deltas, resource)
+                , collection(other.collection)
+                , ranking(other.ranking)
+                , bm25(other.bm25)
+                , plus_terms(other.plus_terms, resource)
+                , minus_postings(other.minus_postings, resource)
+                , average_document_length(other.average_document_length)
+                , generation(other.generation)
+                , has_expansions(other.has_expansions)
+                , use_impact_tier(other.use_impact_tier)
+                , min_tier_recall(other.min_tier_recall) {
+            }
+            Query(const Query&) = default;
+            Query(Query&&) = default;
+            Query& operator=(Query&&) = default;
+
+            bool HasRequiredWords() const {
+                return !required_words.empty() || !required_expansions.empty();
+            }
+
+            //the query in lower case; the words not taken from the index view it
+            std::pmr::vector<char> normalized_text;
+            std::pmr::vector<std::string_view> plus_words;
+            std::pmr::vector<std::string_view> minus_words;
+            std::pmr::vector<Phrase> phrases;
+            //words every found document must contain: phrase words and, in ALL mode, plus words
+            std::pmr::vector<std::string_view> required_words;
+            //expanded plus words in ALL mode: a document must contain one word of each
+            std::pmr::vector<std::pmr::vector<std::string_view>> required_expansions;
+            //field id and weight - 1 for the weighted fields
+            std::pmr::vector<std::pair<int, double>> field_weight_deltas;
+            const CollectionStatistics* collection = nullptr;
+            RankingModel ranking = RankingModel::TF_IDF;
+            Bm25Parameters bm25;
+
+            //a plus word with documents, as the scoring loops need it
+            struct Term {
+                std::string_view word;
+                const std::pmr::map<int, TermFrequency>* postings;
+                //nullptr without field weights
+                const FieldTermCounts* field_counts;
+                //of the ranking model of the query
+                double inverse_document_freq;
+                //nullptr unless the query uses the impact tier
+                const TermImpactTier* impact_tier;
+            };
+            //set by ResolveTerms for the index at generation
+            std::pmr::vector<Term> plus_terms;
+            std::pmr::vector<const std::pmr::map<int, TermFrequency>*> minus_postings;
+            double average_document_length = 0.0;
+            uint64_t generation = 0;
+            bool has_expansions = false;
+            bool use_impact_tier = false;
+            double min_tier_recall = 1.0;
         };
 
 
-    Query ParseQuery(std::string_view text, bool par = 0) const;
+    // Allocates from QueryScratch unless given another resource
+    Query ParseQuery(std::string_view text, QueryMode mode = QueryMode::ANY,
+                     std::pmr::memory_resource* resource = QueryScratch::GetResource()) const;
+    // Also takes the ranking settings of options and resolves the terms
+    Query ParseQuery(std::string_view text, const SearchOptions& options,
+                     std::pmr::memory_resource* resource = QueryScratch::GetResource()) const;
 
-    // Existence required
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    // Looks up the postings and computes the IDF of the plus words, once per query
+    void ResolveTerms(Query& query) const;
+    // A copy of query in QueryScratch resolved at the current generation
+    Query CopyWithCurrentTerms(const Query& query) const;
+    void CheckPreparedQuery(const PreparedQuery& prepared_query) const;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(
-        const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+        const Query& query, int document_id) const;
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const Query& query,
+                                           DocumentPredicate document_predicate) const;
+
+    // The top documents from the impact tier alone, nullopt when the tier can not
+    // guarantee query.min_tier_recall of them. The tier documents are scored over the
+    // full posting lists, in the order of their tier score, until no remaining one can
+    // enter the top. Runs sequentially whatever the policy of the caller
+    template <typename TermScorer, typename DocumentPredicate>
+    std::optional<std::vector<Document>> FindTopTierDocuments(const Query& query,
+                                                              DocumentPredicate document_predicate) const;
+
+    //relevance accumulated by slot, so a thread keeps buffers of the slot count, not of
+    //the largest id; reused by the queries of a thread, only the entries of the previous
+    //query are reset
+    struct DenseRelevance {
+        std::vector<RelevanceAccumulator> relevance;
+        std::vector<char> is_matched;
+        //the slots matched by the query
+        std::vector<int> slots;
+
+        void Prepare(size_t slot_count);
+    };
+    //one buffer per thread for every scorer and predicate type, rather than a
+    //thread_local in each instantiation of the search templates
+    static DenseRelevance& GetThreadRelevance();
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(
-        const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const;
+    bool IsAccepted(int slot, const DocumentPredicate& document_predicate) const;
+
+    bool HasAnyWord(const std::pmr::vector<std::string_view>& words, int slot) const;
+    bool HasPhrase(const Phrase& phrase, int slot) const;
+    // A word of each required expansion and all phrases
+    bool HasRequiredExpansionsAndPhrases(const Query& query, int slot) const;
+    // Everything a document found by the query contains: the required words as well
+    bool HasRequiredWords(const Query& query, int slot) const;
+
+    // Documents containing all required words, a word of each required expansion
+    // and all phrases, as slots in increasing order
+    std::pmr::vector<int> IntersectRequiredWords(const Query& query) const;
+
+    // Collection size and the number of documents with the word; existence required
+    std::pair<int, int> GetWordDocumentCounts(std::string_view word,
+                                              const CollectionStatistics* collection) const;
+    double ComputeWordInverseDocumentFreq(std::string_view word,
+                                          const CollectionStatistics* collection = nullptr) const;
+    // log(1 + (N - n + 0.5) / (n + 0.5)), never negative unlike the classic BM25 IDF
+    double ComputeBm25InverseDocumentFreq(std::string_view word,
+                                          const CollectionStatistics* collection = nullptr) const;
+    double GetAverageDocumentLength(const CollectionStatistics* collection) const;
+
+    // Existence required
+    template <typename TermScorer>
+    TermScorer MakeTermScorer(std::string_view word, const Query& query) const;
+    template <typename TermScorer>
+    TermScorer MakeTermScorer(const Query::Term& term, const Query& query) const;
+
+    // Calls action(slot, term_freq) for every posting, the term frequency
+    // weighted by the field weights of query. The field lists are merged with the
+    // postings in one pass
+    template <typename Action>
+    void ForEachPosting(const Query::Term& term, const Query& query, Action action) const;
+    // The same for a single posting; field_counts may be nullptr
+    double WeighTermFreq(double term_freq, int slot, const FieldTermCounts* field_counts,
+                         const Query& query) const;
+    void RemoveFieldCounts(std::string_view word, int slot);
+
+    // The match filter of a plain search
+    struct KeepAllMatches {
+        bool operator()(int /*slot*/) const {
+            return true;
+        }
+    };
+
+    // Picks the scorer of query.ranking once and runs the matching below with it.
+    // match_filter(slot) is called once for every document matching the query, minus words
+    // applied, from one thread at a time; it returns whether the document is kept
+    template <typename ExecutionPolicy, typename DocumentPredicate, typename MatchFilter = KeepAllMatches>
+    std::pmr::vector<Document> FindAllDocuments(
+        const ExecutionPolicy& policy, const Query& query, DocumentPredicate document_predicate,
+        MatchFilter match_filter = {}) const;
+
+    template <typename TermScorer, typename DocumentPredicate, typename MatchFilter>
+    std::pmr::vector<Document> FindAllDocuments(
+        const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate,
+        MatchFilter match_filter) const;
+
+    template <typename TermScorer, typename DocumentPredicate, typename MatchFilter>
+    std::pmr::vector<Document> FindAllDocuments(
+        const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate,
+        MatchFilter match_filter) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(
+    std::pmr::vector<Document> FindAllDocuments(
         const Query& query, DocumentPredicate document_predicate) const; 
+
+    template <typename TermScorer, typename ExecutionPolicy, typename DocumentPredicate, typename MatchFilter>
+    std::pmr::vector<Document> FindIntersectedDocuments(
+        const ExecutionPolicy& policy, const Query& query, DocumentPredicate document_predicate,
+        MatchFilter match_filter) const;
     
 };
 
+// The parsed and resolved query of one server: plus and minus words point to their
+// posting lists and carry their IDF, so an execution neither parses nor looks words up.
+// After documents are added or removed an execution resolves the words again on a
+// temporary copy; RefreshQuery updates the query itself. term* and term~ keep the words
+// they expanded to until RefreshQuery. Must not outlive the server
+class SearchServer::PreparedQuery {
+public:
+    PreparedQuery(PreparedQuery&&) = default;
+    PreparedQuery& operator=(PreparedQuery&&) = default;
+    //the words view memory of the query itself
+    PreparedQuery(const PreparedQuery&) = delete;
+    PreparedQuery& operator=(const PreparedQuery&) = delete;
+
+    std::string_view GetText() const {
+        return text_;
+    }
+
+private:
+    friend class SearchServer;
+
+    PreparedQuery(const SearchServer* server, std::string text, SearchOptions options, Query query)
+        : server_(server)
+        , text_(std::move(text))
+        , options_(std::move(options))
+        , query_(std::move(query)) {
+    }
+
+    const SearchServer* server_;
+    std::string text_;
+    SearchOptions options_;
+    Query query_;
+};
+
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words)) {
+SearchServer::SearchServer(const StringContainer& stop_words, std::pmr::memory_resource* resource)
+    : stop_words_(NormalizeStopWords(MakeUniqueNonEmptyStrings(stop_words)))
+    , storage_(resource)
+    , normalized_words_(resource)
+    , word_to_document_freqs_(resource)
+    , word_frequencies_(resource)
+    , word_to_document_positions_(resource)
+    , term_dictionary_(resource)
+    , indexed_words_(resource)
+    , field_ids_(resource)
+    , word_to_field_counts_(resource)
+    , word_score_bounds_(resource)
+    , documents_(resource)
+    , document_texts_(resource)
+    , document_attributes_(resource)
+    , status_documents_(DOCUMENT_STATUS_COUNT, resource)
+    , free_slots_(resource)
+    , documents_ids_(resource) {
 
         if (!none_of(stop_words.begin(), stop_words.end(), 
             [](std::string_view word) { return !IsValidWord(word);}))
@@ -153,32 +616,77 @@ SearchServer::SearchServer(const StringContainer& stop_words)
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(
     const ExecutionPolicy& policy, std::string_view raw_query,
+                                  const SearchOptions& options,
                                   DocumentPredicate document_predicate) const {
-    const auto query = ParseQuery(raw_query);
+    QueryScratch::Scope scratch;
+    const auto query = ParseQuery(raw_query, options);
+    return FindTopDocuments(policy, query, document_predicate);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(
+    const ExecutionPolicy& policy, const Query& query, DocumentPredicate document_predicate) const {
+    if (query.use_impact_tier && impact_tier_) {
+        auto tier_documents = query.ranking == RankingModel::BM25
+            ? FindTopTierDocuments<Bm25Scorer>(query, document_predicate)
+            : FindTopTierDocuments<TfIdfScorer>(query, document_predicate);
+        impact_tier_->CountSearch(!tier_documents);
+        if (tier_documents) {
+            return std::move(*tier_documents);
+        }
+    }
     auto matched_documents = FindAllDocuments(policy ,query, document_predicate);
         
-    sort(policy, matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-        double EPSILON = 1e-6;
-        if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-            return lhs.rating > rhs.rating;
-        } else {
-            return lhs.relevance > rhs.relevance;
-        }
-    });
+    sort(policy, matched_documents.begin(), matched_documents.end(), IsRankedBefore);
     if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
         matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
     }
-    return matched_documents;
+    return {matched_documents.begin(), matched_documents.end()};
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(
+    const ExecutionPolicy& policy, const PreparedQuery& prepared_query,
+                                  DocumentPredicate document_predicate) const {
+    CheckPreparedQuery(prepared_query);
+    QueryScratch::Scope scratch;
+    if (prepared_query.query_.generation == generation_) {
+        return FindTopDocuments(policy, prepared_query.query_, document_predicate);
+    }
+    return FindTopDocuments(policy, CopyWithCurrentTerms(prepared_query.query_), document_predicate);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(
+    const ExecutionPolicy& policy, const PreparedQuery& prepared_query) const {
+    return FindTopDocuments(policy, prepared_query, StatusIs{DocumentStatus::ACTUAL});
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(
+    const PreparedQuery& prepared_query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments(std::execution::seq, prepared_query, document_predicate);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(
+    const ExecutionPolicy& policy, std::string_view raw_query, const SearchOptions& options) const {
+    return FindTopDocuments(
+        policy, raw_query, options, StatusIs{DocumentStatus::ACTUAL});
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(
+    const ExecutionPolicy& policy, std::string_view raw_query,
+                                  DocumentPredicate document_predicate) const {
+    return FindTopDocuments(policy, raw_query, SearchOptions{}, document_predicate);
 }
 
 template <typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(
     const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status) const {
     const auto matched_documents = FindTopDocuments(
-        policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-    });
+        policy, raw_query, StatusIs{status});
     return matched_documents;
 }
 
@@ -198,83 +706,391 @@ std::vector<Document> SearchServer::FindTopDocuments(
     return matched_documents;
 }
 
+template <typename ExecutionPolicy, typename DocumentPredicate>
+FacetedSearchResult SearchServer::FindTopDocumentsWithFacets(
+    const ExecutionPolicy& policy, std::string_view raw_query, const std::vector<int>& rating_bounds,
+    const SearchOptions& options, DocumentPredicate document_predicate) const {
+    if (!std::is_sorted(rating_bounds.begin(), rating_bounds.end())) {
+        throw std::invalid_argument("Границы интервалов рейтинга должны быть упорядочены по возрастанию"s);
+    }
+    QueryScratch::Scope scratch;
+    const auto query = ParseQuery(raw_query, options);
+
+    FacetedSearchResult result;
+    result.facets.rating_counts.assign(rating_bounds.size() + 1, 0);
+    //one evaluation for every status: a match is counted from the flat attributes as the
+    //search emits it, and then the predicate decides whether it is kept
+    auto matched_documents = FindAllDocuments(policy, query, AnyDocument{}, [&](int slot) {
+        const DocumentData& document_data = document_attributes_[slot];
+        ++result.facets.status_counts[static_cast<size_t>(document_data.status)];
+        ++result.facets.rating_counts[GetRatingBucket(rating_bounds, document_data.rating)];
+        return IsAccepted(slot, document_predicate);
+    });
+
+    const auto top_end = matched_documents.begin()
+        + std::min(matched_documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    std::partial_sort(matched_documents.begin(), top_end, matched_documents.end(), IsRankedBefore);
+    result.documents.assign(matched_documents.begin(), top_end);
+    return result;
+}
+
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(
-        const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+FacetedSearchResult SearchServer::FindTopDocumentsWithFacets(
+    std::string_view raw_query, const std::vector<int>& rating_bounds,
+    const SearchOptions& options, DocumentPredicate document_predicate) const {
+    return FindTopDocumentsWithFacets(std::execution::seq, raw_query, rating_bounds, options, document_predicate);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+LazilySortedDocuments SearchServer::FindLazilySortedDocuments(
+    const ExecutionPolicy& policy, std::string_view raw_query,
+                                  const SearchOptions& options,
+                                  DocumentPredicate document_predicate) const {
+    QueryScratch::Scope scratch;
+    const auto query = ParseQuery(raw_query, options);
+    const auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+    return LazilySortedDocuments({matched_documents.begin(), matched_documents.end()});
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+LazilySortedDocuments SearchServer::FindLazilySortedDocuments(
+    const ExecutionPolicy& policy, std::string_view raw_query,
+                                  DocumentPredicate document_predicate) const {
+    return FindLazilySortedDocuments(policy, raw_query, SearchOptions{}, document_predicate);
+}
+
+template <typename ExecutionPolicy>
+LazilySortedDocuments SearchServer::FindLazilySortedDocuments(
+    const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status) const {
+    return FindLazilySortedDocuments(
+        policy, raw_query, StatusIs{status});
+}
+
+template <typename ExecutionPolicy>
+LazilySortedDocuments SearchServer::FindLazilySortedDocuments(
+    const ExecutionPolicy& policy, std::string_view raw_query) const {
+    return FindLazilySortedDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename DocumentPredicate>
+LazilySortedDocuments SearchServer::FindLazilySortedDocuments(
+    std::string_view raw_query, DocumentPredicate document_predicate) const {
+    return FindLazilySortedDocuments(std::execution::seq, raw_query, document_predicate);
+}
+
+template <typename DocumentPredicate>
+bool SearchServer::IsAccepted(int slot, const DocumentPredicate& document_predicate) const {
+    if constexpr (std::is_same_v<DocumentPredicate, AnyDocument>) {
+        return true;
+    } else if constexpr (std::is_same_v<DocumentPredicate, StatusIs>) {
+        return status_documents_[static_cast<size_t>(document_predicate.status)][slot];
+    } else if constexpr (std::is_same_v<DocumentPredicate, RatingAtLeast>) {
+        return document_attributes_[slot].rating >= document_predicate.min_rating;
+    } else {
+        const auto& document_data = document_attributes_[slot];
+        return document_predicate(document_data.id, document_data.status, document_data.rating);
+    }
+}
+
+template <typename TermScorer>
+TermScorer SearchServer::MakeTermScorer(std::string_view word, const Query& query) const {
+    if constexpr (std::is_same_v<TermScorer, Bm25Scorer>) {
+        return Bm25Scorer(ComputeBm25InverseDocumentFreq(word, query.collection), query.bm25,
+                          GetAverageDocumentLength(query.collection));
+    } else {
+        return TfIdfScorer(ComputeWordInverseDocumentFreq(word, query.collection));
+    }
+}
+
+template <typename TermScorer>
+TermScorer SearchServer::MakeTermScorer(const Query::Term& term, const Query& query) const {
+    if constexpr (std::is_same_v<TermScorer, Bm25Scorer>) {
+        return Bm25Scorer(term.inverse_document_freq, query.bm25, query.average_document_length);
+    } else {
+        return TfIdfScorer(term.inverse_document_freq);
+    }
+}
+
+template <typename Action>
+void SearchServer::ForEachPosting(const Query::Term& term, const Query& query, Action action) const {
+    const std::pmr::map<int, TermFrequency>& postings = *term.postings;
+    if (term.field_counts == nullptr) {
+        for (const auto [slot, term_freq] : postings) {
+            action(slot, static_cast<double>(term_freq));
+        }
+        return;
+    }
+
+    struct FieldCursor {
+        std::pmr::map<int, int>::const_iterator position;
+        std::pmr::map<int, int>::const_iterator end;
+        double weight_delta;
+    };
+    std::pmr::vector<FieldCursor> cursors(QueryScratch::GetResource());
+    for (const auto& [field_id, weight_delta] : query.field_weight_deltas) {
+        const auto it = term.field_counts->find(field_id);
+        if (it != term.field_counts->end()) {
+            cursors.push_back({it->second.begin(), it->second.end(), weight_delta});
+        }
+    }
+    //every document of a field list is in postings, so the cursors only move forward
+    for (const auto [slot, term_freq] : postings) {
+        double weighted_count = 0.0;
+        for (FieldCursor& cursor : cursors) {
+            if (cursor.position != cursor.end && cursor.position->first == slot) {
+                weighted_count += cursor.weight_delta * cursor.position->second;
+                ++cursor.position;
+            }
+        }
+        action(slot, term_freq + weighted_count / document_attributes_[slot].word_count);
+    }
+}
+
+template <typename TermScorer, typename DocumentPredicate>
+std::optional<std::vector<Document>> SearchServer::FindTopTierDocuments(
+        const Query& query, DocumentPredicate document_predicate) const {
+    if (query.HasRequiredWords() || !query.field_weight_deltas.empty()) {
+        return std::nullopt;
+    }
+    //a document in no tier list of the query scores at most rest_score
+    double rest_score = 0.0;
+    std::pmr::vector<TermScorer> term_scorers(QueryScratch::GetResource());
+    for (const Query::Term& term : query.plus_terms) {
+        //a negative IDF from foreign collection statistics turns the bounds around
+        if (term.impact_tier == nullptr || term.inverse_document_freq < 0.0) {
+            return std::nullopt;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        term_scorers.push_back(MakeTermScorer<TermScorer>(term, query));
+        rest_score += term_scorers.back().GetUpperBound(term.impact_tier->rest_bound);
+    }
+
+    //the full search, if it follows, prepares the buffer again
+    DenseRelevance& tier_relevance = GetThreadRelevance();
+    tier_relevance.Prepare(document_attributes_.size());
+    auto& tier_score = tier_relevance.relevance;
+    auto& is_matched = tier_relevance.is_matched;
+    auto& candidates = tier_relevance.slots;
+    for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+        for (const auto& posting : query.plus_terms[i].impact_tier->postings) {
+            if (IsAccepted(posting.slot, document_predicate)) {
+                if (!is_matched[posting.slot]) {
+                    is_matched[posting.slot] = true;
+                    candidates.push_back(posting.slot);
+                }
+                tier_score[posting.slot] += static_cast<RelevanceAccumulator>(
+                    term_scorers[i](static_cast<double>(posting.term_freq), posting.document_length));
             }
         }
     }
+    std::sort(candidates.begin(), candidates.end(), [&tier_score](int lhs, int rhs) {
+        return tier_score[lhs] > tier_score[rhs];
+    });
 
-    for (std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    const auto has_minus_word = [&query](int slot) {
+        return std::any_of(query.minus_postings.begin(), query.minus_postings.end(), [slot](const auto* postings) {
+            return postings->count(slot) > 0;
+        });
+    };
+    //in the arena, so that a fallback to the full index allocates nothing
+    std::pmr::vector<Document> top_documents(QueryScratch::GetResource());
+    top_documents.reserve(MAX_RESULT_DOCUMENT_COUNT + 1);
+    for (const int slot : candidates) {
+        //the candidates left score at most their tier score plus rest_score
+        if (top_documents.size() == MAX_RESULT_DOCUMENT_COUNT
+            && top_documents.back().relevance >= tier_score[slot] + rest_score + RELEVANCE_EPSILON) {
+            break;
+        }
+        if (has_minus_word(slot)) {
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        //summed in the order of the full search, so the relevance is the same
+        RelevanceAccumulator relevance = 0;
+        const int document_length = document_attributes_[slot].word_count;
+        for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+            const auto it = query.plus_terms[i].postings->find(slot);
+            if (it != query.plus_terms[i].postings->end()) {
+                relevance += static_cast<RelevanceAccumulator>(
+                    term_scorers[i](static_cast<double>(it->second), document_length));
+            }
+        }
+        const Document document(document_attributes_[slot].id, relevance, document_attributes_[slot].rating);
+        if (top_documents.size() < MAX_RESULT_DOCUMENT_COUNT || IsRankedBefore(document, top_documents.back())) {
+            top_documents.insert(
+                std::upper_bound(top_documents.begin(), top_documents.end(), document, IsRankedBefore), document);
+            if (top_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+                top_documents.pop_back();
+            }
+        }
+    }
+
+    //with nothing left out of the tier lists the tier result is exact; otherwise
+    //the documents scoring above rest_score are the first ones of the full result
+    if (rest_score > 0.0) {
+        const auto guaranteed_count = std::count_if(top_documents.begin(), top_documents.end(),
+            [rest_score](const Document& document) {
+                return document.relevance >= rest_score + RELEVANCE_EPSILON;
+            });
+        if (guaranteed_count < std::ceil(query.min_tier_recall * MAX_RESULT_DOCUMENT_COUNT)) {
+            return std::nullopt;
         }
     }
+    return std::vector<Document>(top_documents.begin(), top_documents.end());
+}
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back(
-            {document_id, relevance, documents_.at(document_id).rating});
+template <typename ExecutionPolicy, typename DocumentPredicate, typename MatchFilter>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(
+        const ExecutionPolicy& policy, const Query& query, DocumentPredicate document_predicate,
+        MatchFilter match_filter) const {
+    if (query.ranking == RankingModel::BM25) {
+        return FindAllDocuments<Bm25Scorer>(policy, query, document_predicate, match_filter);
+    }
+    return FindAllDocuments<TfIdfScorer>(policy, query, document_predicate, match_filter);
+}
+
+template <typename TermScorer, typename DocumentPredicate, typename MatchFilter>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(
+        const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate,
+        MatchFilter match_filter) const {
+    if (query.HasRequiredWords()) {
+        return FindIntersectedDocuments<TermScorer>(std::execution::seq, query, document_predicate, match_filter);
+    }
+    DenseRelevance& document_to_relevance = GetThreadRelevance();
+    document_to_relevance.Prepare(document_attributes_.size());
+    auto& relevance = document_to_relevance.relevance;
+    auto& is_matched = document_to_relevance.is_matched;
+    for (const Query::Term& term : query.plus_terms) {
+        const TermScorer term_scorer = MakeTermScorer<TermScorer>(term, query);
+        ForEachPosting(term, query, [&](int slot, double term_freq) {
+            if (IsAccepted(slot, document_predicate)) {
+                if (!is_matched[slot]) {
+                    is_matched[slot] = true;
+                    document_to_relevance.slots.push_back(slot);
+                }
+                relevance[slot] += static_cast<RelevanceAccumulator>(
+                    term_scorer(term_freq, document_attributes_[slot].word_count));
+            }
+        });
+    }
+
+    for (const auto* postings : query.minus_postings) {
+        for (const auto [slot, _] : *postings) {
+            is_matched[slot] = false;
+        }
+    }
+
+    std::pmr::vector<Document> matched_documents(QueryScratch::GetResource());
+    for (const int slot : document_to_relevance.slots) {
+        if (is_matched[slot] && match_filter(slot)) {
+            matched_documents.push_back(
+                {document_attributes_[slot].id, relevance[slot], document_attributes_[slot].rating});
+        }
     }
     return matched_documents;
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(
-        const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const {
+template <typename TermScorer, typename DocumentPredicate, typename MatchFilter>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(
+        const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate,
+        MatchFilter match_filter) const {
+    //on a single hardware thread the locks of the concurrent map only add to the sequential cost
+    static const bool is_single_threaded = std::thread::hardware_concurrency() <= 1;
+    if (is_single_threaded) {
+        return FindAllDocuments<TermScorer>(std::execution::seq, query, document_predicate, match_filter);
+    }
+    if (query.HasRequiredWords()) {
+        return FindIntersectedDocuments<TermScorer>(std::execution::par, query, document_predicate, match_filter);
+    }
    
-    ConcurrentMap<int, double> document_to_relevance(100);
+    ConcurrentMap<int, RelevanceAccumulator> document_to_relevance(100);
 
-    std::for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(), 
-        [&, document_predicate](const auto& word){
-            if (word_to_document_freqs_.count(word) != 0) {
-        
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                        const auto& document_data = documents_.at(document_id);
-                        if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                            document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                        }
+    std::for_each(std::execution::par, query.plus_terms.begin(), query.plus_terms.end(), 
+        [&, document_predicate](const Query::Term& term){
+            const TermScorer term_scorer = MakeTermScorer<TermScorer>(term, query);
+            ForEachPosting(term, query,
+                [&](int slot, double term_freq) {
+                    if (IsAccepted(slot, document_predicate)) {
+                        document_to_relevance[slot].ref_to_value += static_cast<RelevanceAccumulator>(
+                            term_scorer(term_freq, document_attributes_[slot].word_count));
                     }
-            }
+                });
         });
 
     auto ordinary_map = document_to_relevance.BuildOrdinaryMap();
-    for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(),
-        [&](const auto& word){
-            if (word_to_document_freqs_.count(word) != 0) {
-
-                for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                    ordinary_map.erase(document_id);
-                }
+    for_each(std::execution::par, query.minus_postings.begin(), query.minus_postings.end(),
+        [&](const auto* postings){
+            for (const auto [slot, _] : *postings) {
+                ordinary_map.erase(slot);
             }
         });
 
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : ordinary_map) {
-        matched_documents.push_back(
-            {document_id, relevance, documents_.at(document_id).rating});
+    std::pmr::vector<Document> matched_documents(QueryScratch::GetResource());
+    for (const auto [slot, relevance] : ordinary_map) {
+        if (match_filter(slot)) {
+            matched_documents.push_back(
+                {document_attributes_[slot].id, relevance, document_attributes_[slot].rating});
+        }
     }
     return matched_documents;
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(
+std::pmr::vector<Document> SearchServer::FindAllDocuments(
         const Query& query, DocumentPredicate document_predicate) const {
             auto matched_documents = FindAllDocuments(std::execution::seq, query, document_predicate);
     return matched_documents;
 }
+
+template <typename TermScorer, typename ExecutionPolicy, typename DocumentPredicate, typename MatchFilter>
+std::pmr::vector<Document> SearchServer::FindIntersectedDocuments(
+        const ExecutionPolicy& policy, const Query& query, DocumentPredicate document_predicate,
+        MatchFilter match_filter) const {
+    const std::pmr::vector<int> candidates = IntersectRequiredWords(query);
+
+    //optional plus words only add relevance to the candidates
+    struct PlusPostings {
+        const std::pmr::map<int, TermFrequency>* postings;
+        const FieldTermCounts* field_counts;
+        TermScorer term_scorer;
+    };
+    std::pmr::vector<PlusPostings> plus_postings(QueryScratch::GetResource());
+    for (const Query::Term& term : query.plus_terms) {
+        plus_postings.push_back({term.postings, term.field_counts, MakeTermScorer<TermScorer>(term, query)});
+    }
+    const auto has_minus_word = [&query](int slot) {
+        return std::any_of(query.minus_postings.begin(), query.minus_postings.end(), [slot](const auto* postings) {
+            return postings->count(slot) > 0;
+        });
+    };
+
+    std::pmr::vector<Document> matched_documents(candidates.size(), QueryScratch::GetResource());
+    std::transform(policy, candidates.begin(), candidates.end(), matched_documents.begin(),
+        [&, document_predicate](int slot) {
+            if (!IsAccepted(slot, document_predicate)
+                || has_minus_word(slot)) {
+                return Document(-1, 0.0, 0);
+            }
+            RelevanceAccumulator relevance = 0;
+            const int document_length = document_attributes_[slot].word_count;
+            for (const auto& [postings, field_counts, term_scorer] : plus_postings) {
+                const auto it = postings->find(slot);
+                if (it != postings->end()) {
+                    const double term_freq = WeighTermFreq(it->second, slot, field_counts, query);
+                    relevance += static_cast<RelevanceAccumulator>(term_scorer(term_freq, document_length));
+                }
+            }
+            return Document(document_attributes_[slot].id, relevance, document_attributes_[slot].rating);
+        });
+
+    //the filter runs on this thread only
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (matched_documents[i].id >= 0 && !match_filter(candidates[i])) {
+            matched_documents[i].id = -1;
+        }
+    }
+    matched_documents.erase(std::remove_if(matched_documents.begin(), matched_documents.end(),
+        [](const Document& document) {
+            return document.id < 0;
+        }), matched_documents.end());
+    return matched_documents;
+}
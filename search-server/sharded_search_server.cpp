@@ -0,0 +1,161 @@
+#include "sharded_search_server.h"
+
+#include <utility>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+ShardedSearchServer::Shard::Shard(vector<string> stop_words, int cpu) {
+    promise<void> started;
+    future<void> is_started = started.get_future();
+    worker_ = thread([this, cpu, stop_words = move(stop_words), started = move(started)]() mutable {
+        Work(cpu, stop_words, started);
+    });
+    try {
+        //rethrows an error in the stop words
+        is_started.get();
+    } catch (...) {
+        worker_.join();
+        throw;
+    }
+}
+
+ShardedSearchServer::Shard::~Shard() {
+    {
+        lock_guard guard(mutex_);
+        stopping_ = true;
+    }
+    has_tasks_.notify_one();
+    worker_.join();
+}
+
+void ShardedSearchServer::Shard::Work(int cpu, const vector<string>& stop_words, promise<void>& started) {
+#ifdef __linux__
+    if (cpu >= 0) {
+        //memory of the shard is touched first from this thread, so it stays on the core's NUMA node
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpu, &cpu_set);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    }
+#endif
+    try {
+        server_.emplace(stop_words);
+    } catch (...) {
+        started.set_exception(current_exception());
+        return;
+    }
+    started.set_value();
+
+    deque<function<void()>> tasks;
+    while (true) {
+        {
+            unique_lock lock(mutex_);
+            has_tasks_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return;
+            }
+            //the queued writes are drained as one batch, taking the lock once
+            tasks.swap(tasks_);
+        }
+        has_room_.notify_all();
+        for (auto& task : tasks) {
+            task();
+        }
+        tasks.clear();
+    }
+}
+
+future<exception_ptr> ShardedSearchServer::Shard::TakeWriteError() {
+    return Submit([this](SearchServer&) {
+        return exchange(write_error_, nullptr);
+    });
+}
+
+ShardedSearchServer::ShardedSearchServer(string_view stop_words_text, size_t shard_count, bool pin_shards)
+    : ShardedSearchServer(SplitIntoWords(stop_words_text), shard_count, pin_shards) {
+}
+
+ShardedSearchServer::ShardedSearchServer(const string& stop_words_text, size_t shard_count, bool pin_shards)
+    : ShardedSearchServer(string_view(stop_words_text), shard_count, pin_shards) {
+}
+
+void ShardedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
+                                      const vector<int>& ratings) {
+    GetShard(document_id).Post([document_id, document = string(document), status, ratings](SearchServer& server) {
+        server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    GetShard(document_id).Post([document_id](SearchServer& server) {
+        server.RemoveDocument(document_id);
+    });
+}
+
+void ShardedSearchServer::Flush() {
+    //the barrier task of a shard runs after all the writes queued before it
+    vector<future<exception_ptr>> errors;
+    for (const auto& shard : shards_) {
+        errors.push_back(shard->TakeWriteError());
+    }
+    exception_ptr first_error;
+    for (auto& error : errors) {
+        exception_ptr shard_error = error.get();
+        if (!first_error) {
+            first_error = move(shard_error);
+        }
+    }
+    if (first_error) {
+        rethrow_exception(first_error);
+    }
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, SearchOptions{}, StatusIs{status});
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+tuple<vector<string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(
+        string_view raw_query, int document_id) const {
+    return GetShard(document_id).Submit([raw_query, document_id](SearchServer& server) {
+        return server.MatchDocument(raw_query, document_id);
+    }).get();
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    vector<future<int>> counts;
+    for (const auto& shard : shards_) {
+        counts.push_back(shard->Submit([](SearchServer& server) {
+            return server.GetDocumentCount();
+        }));
+    }
+    int document_count = 0;
+    for (auto& count : counts) {
+        document_count += count.get();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+ShardedSearchServer::Shard& ShardedSearchServer::GetShard(int document_id) const {
+    return *shards_[static_cast<size_t>(document_id) % shards_.size()];
+}
+
+int ShardedSearchServer::GetShardCpu(size_t shard_index, bool pin_shards) {
+    const unsigned cpu_count = thread::hardware_concurrency();
+    if (!pin_shards || cpu_count == 0) {
+        return -1;
+    }
+    return static_cast<int>(shard_index % cpu_count);
+}
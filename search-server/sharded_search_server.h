@@ -0,0 +1,219 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "document.h"
+#include "document_predicates.h"
+#include "search_options.h"
+#include "search_server.h"
+
+// Documents are split by doc_id % shard_count between independent SearchServer shards.
+// Every shard is owned by its own worker thread, so shards are filled and searched
+// in parallel, and with pin_shards the workers are bound to separate cores.
+// Writes are queued to the shard without waiting for it. A shard runs its tasks in order,
+// so a search sees every write made before it; Flush() waits for the writes and reports
+// their errors. A search reads the statistics and searches a shard in one task, so
+// a write queued meanwhile lands either before both phases or after both
+class ShardedSearchServer {
+public:
+    template <typename StringContainer>
+    ShardedSearchServer(const StringContainer& stop_words, size_t shard_count, bool pin_shards = false);
+    ShardedSearchServer(std::string_view stop_words_text, size_t shard_count, bool pin_shards = false);
+    ShardedSearchServer(const std::string& stop_words_text, size_t shard_count, bool pin_shards = false);
+
+    // Queue the change and return at once; blocks only while the shard has
+    // a full queue of tasks waiting. Errors, such as a repeated id, are thrown by Flush()
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status,
+                     const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    // Waits until every shard has applied the writes queued so far. Rethrows the first
+    // error of a write since the previous Flush()
+    void Flush();
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const SearchOptions& options,
+                                           DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+        std::string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+    size_t GetShardCount() const;
+
+private:
+    class Shard {
+    public:
+        template <typename StringContainer>
+        Shard(const StringContainer& stop_words, int cpu);
+        // The server is built on the shard thread, after it is pinned to the cpu
+        Shard(std::vector<std::string> stop_words, int cpu);
+        ~Shard();
+
+        // Runs task(server) on the shard thread
+        template <typename Task>
+        auto Submit(Task task) -> std::future<decltype(task(std::declval<SearchServer&>()))>;
+        // Runs write(server) on the shard thread without a future; an exception is kept for TakeWriteError
+        template <typename Write>
+        void Post(Write write);
+        // The first error of a write posted before, cleared
+        std::future<std::exception_ptr> TakeWriteError();
+
+    private:
+        static constexpr size_t MAX_QUEUED_TASKS = 1 << 12;
+
+        //touched on the shard thread only, once it is constructed
+        std::optional<SearchServer> server_;
+        std::mutex mutex_;
+        std::condition_variable has_tasks_;
+        std::condition_variable has_room_;
+        std::deque<std::function<void()>> tasks_;
+        bool stopping_ = false;
+        //touched on the shard thread only
+        std::exception_ptr write_error_;
+        std::thread worker_;
+
+        void Work(int cpu, const std::vector<std::string>& stop_words, std::promise<void>& started);
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    // Searches are queued on all shards under it, so every shard runs them in the same order
+    // and no two searches wait for each other's statistics
+    mutable std::mutex search_mutex_;
+
+    Shard& GetShard(int document_id) const;
+    static int GetShardCpu(size_t shard_index, bool pin_shards);
+};
+
+template <typename StringContainer>
+ShardedSearchServer::Shard::Shard(const StringContainer& stop_words, int cpu)
+    : Shard(std::vector<std::string>(std::begin(stop_words), std::end(stop_words)), cpu) {
+}
+
+template <typename Task>
+auto ShardedSearchServer::Shard::Submit(Task task)
+        -> std::future<decltype(task(std::declval<SearchServer&>()))> {
+    using Result = decltype(task(std::declval<SearchServer&>()));
+    auto packaged = std::make_shared<std::packaged_task<Result()>>(
+        [this, task = std::move(task)]() mutable {
+            return task(*server_);
+        });
+    auto result = packaged->get_future();
+    {
+        std::lock_guard guard(mutex_);
+        tasks_.push_back([packaged] { (*packaged)(); });
+    }
+    has_tasks_.notify_one();
+    return result;
+}
+
+template <typename Write>
+void ShardedSearchServer::Shard::Post(Write write) {
+    {
+        std::unique_lock lock(mutex_);
+        has_room_.wait(lock, [this] { return tasks_.size() < MAX_QUEUED_TASKS; });
+        tasks_.push_back([this, write = std::move(write)]() mutable {
+            try {
+                write(*server_);
+            } catch (...) {
+                if (!write_error_) {
+                    write_error_ = std::current_exception();
+                }
+            }
+        });
+    }
+    has_tasks_.notify_one();
+}
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(const StringContainer& stop_words, size_t shard_count,
+                                         bool pin_shards) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("Количество шардов должно быть положительным"s);
+    }
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(std::make_unique<Shard>(stop_words, GetShardCpu(i, pin_shards)));
+    }
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+        std::string_view raw_query, const SearchOptions& options,
+        DocumentPredicate document_predicate) const {
+    //scatter: IDF has to be computed over the whole collection. A shard task sends its
+    //statistics, waits for the merged ones and searches, with no write in between
+    std::promise<CollectionStatistics> merged_statistics;
+    const std::shared_future<CollectionStatistics> collection = merged_statistics.get_future().share();
+    std::vector<std::future<CollectionStatistics>> statistics_parts;
+    std::vector<std::future<std::vector<Document>>> shard_results;
+    {
+        std::lock_guard guard(search_mutex_);
+        for (const auto& shard : shards_) {
+            std::promise<CollectionStatistics> part;
+            statistics_parts.push_back(part.get_future());
+            auto search = [raw_query, &options, document_predicate, part = std::move(part),
+                           collection](SearchServer& server) mutable {
+                try {
+                    part.set_value(server.GetQueryStatistics(raw_query));
+                } catch (...) {
+                    part.set_exception(std::current_exception());
+                }
+                SearchOptions shard_options = options;
+                shard_options.collection = &collection.get();
+                return server.FindTopDocuments(std::execution::seq, raw_query, shard_options, document_predicate);
+            };
+            shard_results.push_back(shard->Submit(std::move(search)));
+        }
+    }
+    CollectionStatistics merged;
+    std::exception_ptr error;
+    for (auto& part : statistics_parts) {
+        try {
+            merged.Merge(part.get());
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    if (error) {
+        merged_statistics.set_exception(error);
+    } else {
+        merged_statistics.set_value(std::move(merged));
+    }
+
+    //gather: every shard returns its own top, the global top is among them.
+    //All the tasks are waited for, they refer to the query and the options
+    std::vector<Document> matched_documents;
+    for (auto& result : shard_results) {
+        try {
+            const auto documents = result.get();
+            matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    const size_t result_count = std::min(matched_documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    std::partial_sort(matched_documents.begin(), matched_documents.begin() + result_count,
+                      matched_documents.end(), IsRankedBefore);
+    matched_documents.resize(result_count);
+    return matched_documents;
+}
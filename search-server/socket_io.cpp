@@ -0,0 +1,219 @@
+#include "socket_io.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const string UNIX_PREFIX = "unix:"s;
+
+bool IsUnixAddress(const string& address) {
+    return address.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0;
+}
+
+sockaddr_un MakeUnixAddress(const string& address) {
+    const string path = address.substr(UNIX_PREFIX.size());
+    sockaddr_un unix_address{};
+    if (path.empty() || path.size() >= sizeof(unix_address.sun_path)) {
+        throw invalid_argument("Некорректный путь к сокету: "s + address);
+    }
+    unix_address.sun_family = AF_UNIX;
+    memcpy(unix_address.sun_path, path.data(), path.size());
+    return unix_address;
+}
+
+addrinfo* ResolveTcpAddress(const string& address, bool passive) {
+    const size_t colon = address.rfind(':');
+    if (colon == string::npos) {
+        throw invalid_argument("Адрес должен иметь вид host:port или unix:path: "s + address);
+    }
+    const string host = address.substr(0, colon);
+    const string port = address.substr(colon + 1);
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0) {
+        throw invalid_argument("Не удалось разрешить адрес "s + address);
+    }
+    return result;
+}
+
+int GetTimeoutMs(SocketClock::time_point deadline) {
+    if (deadline == SocketClock::time_point::max()) {
+        return -1;
+    }
+    const auto left = chrono::duration_cast<chrono::milliseconds>(deadline - SocketClock::now()).count();
+    return left > 0 ? static_cast<int>(left) : 0;
+}
+
+bool WaitFor(int fd, short events, SocketClock::time_point deadline) {
+    pollfd descriptor{fd, events, 0};
+    while (true) {
+        const int ready = poll(&descriptor, 1, GetTimeoutMs(deadline));
+        if (ready > 0) {
+            return true;
+        }
+        if (ready == 0 || errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+void DisableNagle(int fd) {
+    const int enable = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+}
+
+}  // namespace
+
+int OpenListeningSocket(const string& address) {
+    if (IsUnixAddress(address)) {
+        const sockaddr_un unix_address = MakeUnixAddress(address);
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(unix_address.sun_path);
+        if (fd < 0 || bind(fd, reinterpret_cast<const sockaddr*>(&unix_address), sizeof(unix_address)) != 0
+            || listen(fd, SOMAXCONN) != 0) {
+            CloseSocket(fd);
+            throw runtime_error("Не удалось открыть сокет "s + address + ": "s + strerror(errno));
+        }
+        return fd;
+    }
+
+    addrinfo* resolved = ResolveTcpAddress(address, true);
+    int fd = -1;
+    for (addrinfo* it = resolved; it != nullptr && fd < 0; it = it->ai_next) {
+        fd = socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        const int enable = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        if (bind(fd, it->ai_addr, it->ai_addrlen) != 0 || listen(fd, SOMAXCONN) != 0) {
+            CloseSocket(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(resolved);
+    if (fd < 0) {
+        throw runtime_error("Не удалось открыть сокет "s + address + ": "s + strerror(errno));
+    }
+    return fd;
+}
+
+int ConnectSocket(const string& address, SocketClock::time_point deadline) {
+    auto try_connect = [deadline](int fd, const sockaddr* socket_address, socklen_t length) {
+        SetNonBlocking(fd);
+        if (connect(fd, socket_address, length) == 0) {
+            return true;
+        }
+        if (errno != EINPROGRESS || !WaitFor(fd, POLLOUT, deadline)) {
+            return false;
+        }
+        int error = 0;
+        socklen_t error_length = sizeof(error);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_length);
+        return error == 0;
+    };
+
+    if (IsUnixAddress(address)) {
+        const sockaddr_un unix_address = MakeUnixAddress(address);
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || !try_connect(fd, reinterpret_cast<const sockaddr*>(&unix_address), sizeof(unix_address))) {
+            CloseSocket(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    addrinfo* resolved = ResolveTcpAddress(address, false);
+    int fd = -1;
+    for (addrinfo* it = resolved; it != nullptr && fd < 0; it = it->ai_next) {
+        fd = socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+        if (fd >= 0 && !try_connect(fd, it->ai_addr, it->ai_addrlen)) {
+            CloseSocket(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(resolved);
+    if (fd >= 0) {
+        DisableNagle(fd);
+    }
+    return fd;
+}
+
+void SetNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+void CloseSocket(int fd) {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool WriteAll(int fd, const char* data, size_t size, SocketClock::time_point deadline) {
+    while (size > 0) {
+        const ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+        if (written > 0) {
+            data += written;
+            size -= static_cast<size_t>(written);
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!WaitFor(fd, POLLOUT, deadline)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ReadAll(int fd, char* data, size_t size, SocketClock::time_point deadline) {
+    while (size > 0) {
+        const ssize_t received = recv(fd, data, size, 0);
+        if (received > 0) {
+            data += received;
+            size -= static_cast<size_t>(received);
+        } else if (received < 0 && errno == EINTR) {
+            continue;
+        } else if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!WaitFor(fd, POLLIN, deadline)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t ReadSome(int fd, char* data, size_t size, SocketClock::time_point deadline) {
+    while (true) {
+        const ssize_t received = recv(fd, data, size, 0);
+        if (received >= 0) {
+            return static_cast<size_t>(received);
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if ((errno != EAGAIN && errno != EWOULDBLOCK) || !WaitFor(fd, POLLIN, deadline)) {
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+// POSIX socket helpers shared by the network parts of the search server.
+// Address format: "unix:/path/to/socket" or "host:port"
+
+using SocketClock = std::chrono::steady_clock;
+
+// Throws std::runtime_error if the address can not be bound
+int OpenListeningSocket(const std::string& address);
+
+// Returns -1 if the connection is not established before the deadline
+int ConnectSocket(const std::string& address, SocketClock::time_point deadline);
+
+void SetNonBlocking(int fd);
+void CloseSocket(int fd);
+
+// Work with both blocking and non-blocking sockets.
+// false — error, closed connection or the deadline has passed
+bool WriteAll(int fd, const char* data, size_t size,
+              SocketClock::time_point deadline = SocketClock::time_point::max());
+bool ReadAll(int fd, char* data, size_t size,
+             SocketClock::time_point deadline = SocketClock::time_point::max());
+
+// Reads whatever is available, waiting for at least one byte.
+// 0 — error, closed connection or the deadline has passed
+size_t ReadSome(int fd, char* data, size_t size,
+                SocketClock::time_point deadline = SocketClock::time_point::max());
@@ -9,6 +9,18 @@
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
+// Appends the words to words, for containers with their own allocator
+template <typename WordContainer>
+void SplitIntoWords(std::string_view text, WordContainer& words) {
+    text.remove_prefix(std::min(text.find_first_not_of(' '), text.size()));
+    while (!text.empty()) {
+        const size_t space = std::min(text.find(' '), text.size());
+        words.push_back(text.substr(0, space));
+        text.remove_prefix(space);
+        text.remove_prefix(std::min(text.find_first_not_of(' '), text.size()));
+    }
+}
+
 
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
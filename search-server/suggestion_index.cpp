@@ -0,0 +1,285 @@
+#include "suggestion_index.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+#include "memory_usage.h"
+#include "text_normalization.h"
+
+using namespace std;
+
+namespace {
+
+u32string DecodeWord(string_view word) {
+    u32string letters;
+    for (size_t pos = 0; pos < word.size();) {
+        letters.push_back(DecodeCharacter(word, pos));
+    }
+    return letters;
+}
+
+string NormalizeWord(string_view word) {
+    string normalized(word.size(), '\0');
+    if (!NormalizeText(word, normalized.data())) {
+        throw invalid_argument("В слове для подсказки \""s + string(word)
+                               + "\" есть недопустимые символы с кодами от 0 до 31 или нарушена кодировка UTF-8"s);
+    }
+    return normalized;
+}
+
+//optimal string alignment distance: Levenshtein plus swaps of adjacent letters;
+//max_edits + 1 for anything farther than max_edits
+int ComputeEditDistance(const u32string& lhs, const u32string& rhs, int max_edits) {
+    if (abs(static_cast<int>(lhs.size()) - static_cast<int>(rhs.size())) > max_edits) {
+        return max_edits + 1;
+    }
+    const size_t width = rhs.size() + 1;
+    vector<int> rows(3 * width);
+    int* before_previous = &rows[0];
+    int* previous = &rows[width];
+    int* current = &rows[2 * width];
+    for (size_t j = 0; j < width; ++j) {
+        previous[j] = static_cast<int>(j);
+    }
+    for (size_t i = 1; i <= lhs.size(); ++i) {
+        current[0] = static_cast<int>(i);
+        int row_min = current[0];
+        for (size_t j = 1; j < width; ++j) {
+            current[j] = min({previous[j] + 1, current[j - 1] + 1,
+                              previous[j - 1] + (lhs[i - 1] == rhs[j - 1] ? 0 : 1)});
+            if (i > 1 && j > 1 && lhs[i - 1] == rhs[j - 2] && lhs[i - 2] == rhs[j - 1]) {
+                current[j] = min(current[j], before_previous[j - 2] + 1);
+            }
+            row_min = min(row_min, current[j]);
+        }
+        if (row_min > max_edits) {
+            return max_edits + 1;
+        }
+        int* const reused = before_previous;
+        before_previous = previous;
+        previous = current;
+        current = reused;
+    }
+    return min(previous[rhs.size()], max_edits + 1);
+}
+
+} // namespace
+
+SuggestionIndex::SuggestionIndex(SuggestionOptions options)
+    : options_(options) {
+    if (options_.max_edits < 1 || options_.max_edits > 2) {
+        throw invalid_argument("Число правок в подсказках должно быть 1 или 2"s);
+    }
+    if (options_.prefix_length < 1 || options_.max_completions < 1) {
+        throw invalid_argument("Длина префикса и число дополнений в подсказках должны быть положительными"s);
+    }
+    trie_.emplace_back();
+}
+
+void SuggestionIndex::SetDocumentCount(string_view word, int document_count) {
+    const auto it = word_ids_.find(word);
+    const int word_id = it == word_ids_.end() ? AddWord(word) : it->second;
+    const int old_count = document_counts_[word_id];
+    document_counts_[word_id] = document_count;
+    if (document_count > old_count) {
+        Promote(word_id);
+    } else if (document_count < old_count) {
+        Demote(word_id);
+    }
+}
+
+vector<Suggestion> SuggestionIndex::SuggestCorrections(string_view word, size_t max_count) const {
+    vector<Suggestion> result;
+    const u32string letters = DecodeWord(NormalizeWord(word));
+    if (letters.empty() || max_count == 0) {
+        return result;
+    }
+    vector<int> candidates;
+    for (const uint64_t hash : GetDeleteHashes(letters)) {
+        const auto it = deletes_.find(hash);
+        if (it != deletes_.end()) {
+            candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+        }
+    }
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+    for (const int word_id : candidates) {
+        if (document_counts_[word_id] == 0) {
+            continue;
+        }
+        const int edits = ComputeEditDistance(letters, DecodeWord(words_[word_id]), options_.max_edits);
+        if (edits <= options_.max_edits) {
+            result.push_back({words_[word_id], document_counts_[word_id], edits});
+        }
+    }
+    sort(result.begin(), result.end(), [](const Suggestion& lhs, const Suggestion& rhs) {
+        return tie(lhs.edits, rhs.document_count, lhs.word) < tie(rhs.edits, lhs.document_count, rhs.word);
+    });
+    if (result.size() > max_count) {
+        result.resize(max_count);
+    }
+    return result;
+}
+
+vector<Suggestion> SuggestionIndex::SuggestCompletions(string_view prefix, size_t max_count) const {
+    vector<Suggestion> result;
+    const int node = FindNode(NormalizeWord(prefix));
+    if (node < 0) {
+        return result;
+    }
+    const auto& completions = trie_[node].completions;
+    for (size_t i = 0; i < completions.size() && i < max_count; ++i) {
+        result.push_back({words_[completions[i]], document_counts_[completions[i]], 0});
+    }
+    return result;
+}
+
+size_t SuggestionIndex::GetMemoryUsage() const {
+    size_t bytes = GetHashTableMemory(word_ids_) + GetVectorMemory(words_) + GetVectorMemory(document_counts_)
+        + GetVectorMemory(word_nodes_) + GetVectorMemory(trie_) + GetHashTableMemory(deletes_);
+    for (const TrieNode& node : trie_) {
+        bytes += GetVectorMemory(node.completions);
+    }
+    for (const auto& [hash, word_ids] : deletes_) {
+        bytes += GetVectorMemory(word_ids);
+    }
+    return bytes;
+}
+
+bool SuggestionIndex::IsMoreFrequent(int lhs_word_id, int rhs_word_id) const {
+    if (document_counts_[lhs_word_id] != document_counts_[rhs_word_id]) {
+        return document_counts_[lhs_word_id] > document_counts_[rhs_word_id];
+    }
+    return words_[lhs_word_id] < words_[rhs_word_id];
+}
+
+int SuggestionIndex::AddWord(string_view word) {
+    const int word_id = static_cast<int>(words_.size());
+    word_ids_.emplace(word, word_id);
+    words_.push_back(word);
+    document_counts_.push_back(0);
+
+    const u32string letters = DecodeWord(word);
+    int node = 0;
+    for (const char32_t letter : letters) {
+        //children are kept in letter order
+        int previous_child = -1;
+        int child = trie_[node].first_child;
+        while (child >= 0 && trie_[child].letter < letter) {
+            previous_child = child;
+            child = trie_[child].next_sibling;
+        }
+        if (child < 0 || trie_[child].letter != letter) {
+            TrieNode new_child;
+            new_child.parent = node;
+            new_child.next_sibling = child;
+            new_child.letter = letter;
+            child = static_cast<int>(trie_.size());
+            trie_.push_back(move(new_child));
+            (previous_child < 0 ? trie_[node].first_child : trie_[previous_child].next_sibling) = child;
+        }
+        node = child;
+    }
+    trie_[node].word_id = word_id;
+    word_nodes_.push_back(node);
+
+    for (const uint64_t hash : GetDeleteHashes(letters)) {
+        deletes_[hash].push_back(word_id);
+    }
+    return word_id;
+}
+
+int SuggestionIndex::FindNode(string_view prefix) const {
+    int node = 0;
+    for (size_t pos = 0; pos < prefix.size();) {
+        const char32_t letter = DecodeCharacter(prefix, pos);
+        int child = trie_[node].first_child;
+        while (child >= 0 && trie_[child].letter != letter) {
+            child = trie_[child].next_sibling;
+        }
+        if (child < 0) {
+            return -1;
+        }
+        node = child;
+    }
+    return node;
+}
+
+vector<uint64_t> SuggestionIndex::GetDeleteHashes(const u32string& letters) const {
+    vector<u32string> variants = {letters.substr(0, options_.prefix_length)};
+    size_t edited_begin = 0;
+    for (int edits = 0; edits < options_.max_edits; ++edits) {
+        const size_t edited_end = variants.size();
+        for (size_t i = edited_begin; i < edited_end; ++i) {
+            for (size_t position = 0; position < variants[i].size(); ++position) {
+                u32string variant = variants[i];
+                variant.erase(position, 1);
+                variants.push_back(move(variant));
+            }
+        }
+        edited_begin = edited_end;
+    }
+    vector<uint64_t> hashes;
+    hashes.reserve(variants.size());
+    for (const u32string& variant : variants) {
+        hashes.push_back(hash<u32string>{}(variant));
+    }
+    sort(hashes.begin(), hashes.end());
+    hashes.erase(unique(hashes.begin(), hashes.end()), hashes.end());
+    return hashes;
+}
+
+void SuggestionIndex::Promote(int word_id) {
+    const size_t max_completions = static_cast<size_t>(options_.max_completions);
+    for (int node = word_nodes_[word_id]; node >= 0; node = trie_[node].parent) {
+        auto& completions = trie_[node].completions;
+        auto it = find(completions.begin(), completions.end(), word_id);
+        if (it == completions.end()) {
+            //words beating it here beat it in every shorter prefix too
+            if (completions.size() < max_completions) {
+                completions.push_back(word_id);
+            } else if (IsMoreFrequent(word_id, completions.back())) {
+                completions.back() = word_id;
+            } else {
+                return;
+            }
+            it = completions.end() - 1;
+        }
+        for (; it != completions.begin() && IsMoreFrequent(*it, *(it - 1)); --it) {
+            iter_swap(it, it - 1);
+        }
+    }
+}
+
+void SuggestionIndex::Demote(int word_id) {
+    for (int node = word_nodes_[word_id]; node >= 0; node = trie_[node].parent) {
+        const auto& completions = trie_[node].completions;
+        if (find(completions.begin(), completions.end(), word_id) == completions.end()) {
+            return;
+        }
+        RebuildCompletions(node);
+    }
+}
+
+void SuggestionIndex::RebuildCompletions(int node) {
+    //the completions of the children are exact, so the best words of the subtree are among them
+    vector<int> candidates;
+    const int own_word = trie_[node].word_id;
+    if (own_word >= 0 && document_counts_[own_word] > 0) {
+        candidates.push_back(own_word);
+    }
+    for (int child = trie_[node].first_child; child >= 0; child = trie_[child].next_sibling) {
+        candidates.insert(candidates.end(), trie_[child].completions.begin(), trie_[child].completions.end());
+    }
+    const auto middle = candidates.begin()
+        + min(candidates.size(), static_cast<size_t>(options_.max_completions));
+    partial_sort(candidates.begin(), middle, candidates.end(), [this](int lhs, int rhs) {
+        return IsMoreFrequent(lhs, rhs);
+    });
+    candidates.erase(middle, candidates.end());
+    trie_[node].completions = move(candidates);
+}
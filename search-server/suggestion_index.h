@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct SuggestionOptions {
+    // Corrections differ from the typed word by at most max_edits insertions,
+    // deletions, substitutions or swaps of adjacent letters (1 or 2)
+    int max_edits = 1;
+    // Deletes are indexed for the first prefix_length letters (code points) of a word
+    // only, which bounds the index size; candidates are still checked against the whole word
+    int prefix_length = 7;
+    // Completions kept per prefix, the most a single SuggestCompletions returns
+    int max_completions = 10;
+};
+
+struct Suggestion {
+    std::string_view word;
+    int document_count = 0;
+    int edits = 0;
+};
+
+// Corrections and completions from the vocabulary of an index, by document frequency.
+// Corrections use symmetric deletes: a word is found through the strings left after
+// deleting up to max_edits letters from it and from the typed word. Completions are
+// read from a prefix trie whose every node keeps its max_completions most frequent
+// words, maintained on each document count change. Letters are code points, so a
+// Cyrillic letter is one edit and one trie node, as a Latin one is
+class SuggestionIndex {
+public:
+    explicit SuggestionIndex(SuggestionOptions options = {});
+
+    // Sets the number of documents containing word, adding the word if it is new.
+    // word must outlive the index; words with no documents are not suggested
+    void SetDocumentCount(std::string_view word, int document_count);
+
+    // The typed text goes through NormalizeText, as queries do, so "П" completes to "поиск".
+    // Both throw std::invalid_argument for invalid UTF-8 or a character with a code below 32
+
+    // The closest and then the most frequent words first
+    std::vector<Suggestion> SuggestCorrections(std::string_view word, size_t max_count) const;
+    // The most frequent words starting with prefix first
+    std::vector<Suggestion> SuggestCompletions(std::string_view prefix, size_t max_count) const;
+
+    // Estimated heap bytes, see memory_usage.h
+    size_t GetMemoryUsage() const;
+
+private:
+    struct TrieNode {
+        int parent = -1;
+        int first_child = -1;
+        int next_sibling = -1;
+        int word_id = -1;
+        char32_t letter = 0;
+        //word ids, the most frequent first
+        std::vector<int> completions;
+    };
+
+    SuggestionOptions options_;
+    std::unordered_map<std::string_view, int> word_ids_;
+    std::vector<std::string_view> words_;
+    std::vector<int> document_counts_;
+    std::vector<int> word_nodes_;
+    std::vector<TrieNode> trie_;
+    //hash of a deletes string to the words it is made from
+    std::unordered_map<uint64_t, std::vector<int>> deletes_;
+
+    bool IsMoreFrequent(int lhs_word_id, int rhs_word_id) const;
+    int AddWord(std::string_view word);
+    int FindNode(std::string_view prefix) const;
+    std::vector<uint64_t> GetDeleteHashes(const std::u32string& letters) const;
+    // Moves the word up in the completions of its prefixes after its count grew
+    void Promote(int word_id);
+    // Rebuilds the completions holding the word after its count dropped
+    void Demote(int word_id);
+    void RebuildCompletions(int node);
+};
@@ -0,0 +1,171 @@
+#include "term_dictionary.h"
+
+#include <algorithm>
+
+#include "memory_usage.h"
+#include "query_scratch.h"
+#include "text_normalization.h"
+
+using namespace std;
+
+namespace {
+
+using Entries = pmr::vector<TermDictionary::Entry>;
+
+bool StartsWith(string_view word, string_view prefix) {
+    return word.substr(0, prefix.size()) == prefix;
+}
+
+bool IsWordLess(const TermDictionary::Entry& lhs, const TermDictionary::Entry& rhs) {
+    return lhs.word < rhs.word;
+}
+
+//first word after first that does not start with prefix; *first does.
+//Gallops, as most skipped runs are short
+Entries::const_iterator SkipPrefix(Entries::const_iterator first, Entries::const_iterator last,
+                                   string_view prefix) {
+    size_t step = 1;
+    while (static_cast<size_t>(last - first) > step && StartsWith(first[step].word, prefix)) {
+        first += step;
+        step *= 2;
+    }
+    const auto bound = first + min(step, static_cast<size_t>(last - first));
+    return partition_point(first, bound, [prefix](const TermDictionary::Entry& entry) {
+        return StartsWith(entry.word, prefix);
+    });
+}
+
+//pattern is decoded into code points, and a word is walked one code point at a time,
+//so that a two-byte Cyrillic letter counts as one edit, as an ASCII letter does
+void FindWithinDistanceIn(const Entries& words, const pmr::vector<char32_t>& pattern, int max_edits,
+                          pmr::vector<int>& rows, pmr::vector<size_t>& letter_ends,
+                          pmr::vector<TermDictionary::Match>& matches) {
+    //rows[depth] holds the distances between the first depth letters of a word and the
+    //prefixes of pattern; rows[0] is filled by the caller. A word longer than
+    //pattern + max_edits is out of reach, so no deeper row is needed.
+    //letter_ends[depth] is the byte length of the first depth letters of previous_word
+    const size_t width = pattern.size() + 1;
+    const size_t max_depth = pattern.size() + max_edits;
+
+    string_view previous_word;
+    size_t valid_depth = 0;  //rows computed for previous_word
+    auto it = words.begin();
+    while (it != words.end()) {
+        const string_view word = it->word;
+        const size_t common_limit = min(letter_ends[valid_depth], word.size());
+        size_t common_bytes = 0;
+        while (common_bytes < common_limit && word[common_bytes] == previous_word[common_bytes]) {
+            ++common_bytes;
+        }
+        //UTF-8 is prefix-free: equal bytes up to a letter end are equal letters
+        size_t depth = 0;
+        while (depth < valid_depth && letter_ends[depth + 1] <= common_bytes) {
+            ++depth;
+        }
+
+        bool is_pruned = false;
+        size_t pos = letter_ends[depth];
+        while (pos < word.size()) {
+            if (depth == max_depth) {
+                is_pruned = true;
+                break;
+            }
+            const char32_t letter = DecodeCharacter(word, pos);
+            letter_ends[depth + 1] = pos;
+            const int* above = &rows[depth * width];
+            int* row = &rows[(depth + 1) * width];
+            row[0] = static_cast<int>(depth + 1);
+            int row_min = row[0];
+            for (size_t j = 1; j < width; ++j) {
+                row[j] = min({above[j] + 1, row[j - 1] + 1,
+                              above[j - 1] + (letter == pattern[j - 1] ? 0 : 1)});
+                row_min = min(row_min, row[j]);
+            }
+            ++depth;
+            if (row_min > max_edits) {
+                is_pruned = true;
+                break;
+            }
+        }
+        previous_word = word;
+        valid_depth = depth;
+
+        if (is_pruned) {
+            //no word starting with the first depth letters of word can get within max_edits
+            it = SkipPrefix(it, words.end(), word.substr(0, letter_ends[depth]));
+            continue;
+        }
+        const int edits = rows[depth * width + pattern.size()];
+        if (edits <= max_edits) {
+            matches.push_back({it->word_id, edits});
+        }
+        ++it;
+    }
+}
+
+} // namespace
+
+TermDictionary::TermDictionary(pmr::memory_resource* resource)
+    : words_(resource)
+    , word_chars_(resource)
+    , recent_words_(resource) {
+}
+
+int TermDictionary::Insert(string_view word) {
+    const Entry entry{word, static_cast<int>(GetWordCount())};
+    recent_words_.insert(upper_bound(recent_words_.begin(), recent_words_.end(), entry, IsWordLess), entry);
+    if (recent_words_.size() < RECENT_WORDS_LIMIT) {
+        return entry.word_id;
+    }
+    Entries words(words_.get_allocator());
+    words.reserve(words_.size() + recent_words_.size());
+    merge(words_.begin(), words_.end(), recent_words_.begin(), recent_words_.end(),
+          back_inserter(words), IsWordLess);
+    pmr::vector<char> word_chars(word_chars_.get_allocator());
+    word_chars.reserve(word_chars_.size() + RECENT_WORDS_LIMIT * 16);
+    for (const Entry& merged : words) {
+        word_chars.insert(word_chars.end(), merged.word.begin(), merged.word.end());
+    }
+    size_t offset = 0;
+    for (Entry& merged : words) {
+        merged.word = string_view(word_chars.data() + offset, merged.word.size());
+        offset += merged.word.size();
+    }
+    words_ = move(words);
+    word_chars_ = move(word_chars);
+    recent_words_.clear();
+    return entry.word_id;
+}
+
+size_t TermDictionary::GetWordCount() const {
+    return words_.size() + recent_words_.size();
+}
+
+size_t TermDictionary::GetMemoryUsage() const {
+    return GetVectorMemory(words_) + GetVectorMemory(word_chars_) + GetVectorMemory(recent_words_);
+}
+
+void TermDictionary::FindByPrefix(string_view prefix, pmr::vector<Match>& matches) const {
+    for (const auto* words : {&words_, &recent_words_}) {
+        for (auto it = lower_bound(words->begin(), words->end(), Entry{prefix, 0}, IsWordLess);
+             it != words->end() && StartsWith(it->word, prefix); ++it) {
+            matches.push_back({it->word_id, 0});
+        }
+    }
+}
+
+void TermDictionary::FindWithinDistance(string_view pattern, int max_edits,
+                                        pmr::vector<Match>& matches) const {
+    pmr::vector<char32_t> letters(QueryScratch::GetResource());
+    for (size_t pos = 0; pos < pattern.size();) {
+        letters.push_back(DecodeCharacter(pattern, pos));
+    }
+    const size_t width = letters.size() + 1;
+    pmr::vector<int> rows(width * (letters.size() + max_edits + 1), QueryScratch::GetResource());
+    for (size_t j = 0; j < width; ++j) {
+        rows[j] = static_cast<int>(j);
+    }
+    pmr::vector<size_t> letter_ends(letters.size() + max_edits + 1, 0, QueryScratch::GetResource());
+    FindWithinDistanceIn(words_, letters, max_edits, rows, letter_ends, matches);
+    FindWithinDistanceIn(recent_words_, letters, max_edits, rows, letter_ends, matches);
+}
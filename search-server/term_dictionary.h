@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+// The distinct words of an index as a sorted array, for prefix and fuzzy lookups.
+// Words get ids 0, 1, 2... in the order of insertion. New words go to a small sorted
+// buffer that is merged into the main array when it fills up, so neither an insertion
+// nor a lookup walks a tree
+class TermDictionary {
+public:
+    struct Match {
+        int word_id;
+        int edits;
+    };
+
+    explicit TermDictionary(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // word must not be in the dictionary yet and must outlive the next insertion.
+    // Returns the id of the word
+    int Insert(std::string_view word);
+
+    size_t GetWordCount() const;
+    // Estimated heap bytes, see memory_usage.h
+    size_t GetMemoryUsage() const;
+
+    // Appends the words starting with prefix, edits = 0
+    void FindByPrefix(std::string_view prefix, std::pmr::vector<Match>& matches) const;
+
+    // Appends the words within max_edits insertions, deletions and substitutions of letters
+    // (code points) of pattern.
+    // The sorted words are walked as a trie: the Levenshtein rows of a common prefix are
+    // reused, and all words with a prefix already too far from pattern are skipped at once.
+    // Temporaries come from QueryScratch
+    void FindWithinDistance(std::string_view pattern, int max_edits,
+                            std::pmr::vector<Match>& matches) const;
+
+    struct Entry {
+        std::string_view word;
+        int word_id;
+    };
+
+private:
+    static constexpr size_t RECENT_WORDS_LIMIT = 4096;
+
+    //the words of words_ view word_chars_, laid out in the order of words_ so that
+    //a walk over the dictionary reads memory sequentially
+    std::pmr::vector<Entry> words_;
+    std::pmr::vector<char> word_chars_;
+    std::pmr::vector<Entry> recent_words_;
+};
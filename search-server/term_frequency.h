@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// Storage of term frequencies in the postings, chosen at compile time:
+//   default                         double, relevance accumulated in double
+//   -DSEARCH_SERVER_TF_FLOAT        float, relevance accumulated in float
+//   -DSEARCH_SERVER_TF_QUANTIZED    16-bit fixed point, relevance accumulated in float
+//
+// Tolerance against the double ranking. A float TF has a relative error of 6e-8,
+// a quantized TF (a share of the document words, 0..1) an absolute error of
+// 1 / (2 * 65535) = 7.6e-6. So the relevance of a document is off by at most
+// e = (TF error) * (sum of IDF of the query words), plus 6e-8 relative per float
+// addition. IsRankedBefore treats relevances closer than RELEVANCE_EPSILON as equal
+// and compares ratings. The double order is kept for every pair of documents
+// except those whose double relevances differ by RELEVANCE_EPSILON +- 2e.
+// RELEVANCE_EPSILON is raised above 2e for typical queries (5 words with IDF
+// up to 5), so documents with equal relevance under double, e.g. duplicates,
+// still tie and are ordered by rating.
+
+class QuantizedTermFrequency {
+public:
+    static constexpr double SCALE = 65535.0;
+
+    QuantizedTermFrequency() = default;
+
+    QuantizedTermFrequency(double term_freq)
+        : value_(static_cast<uint16_t>(std::lround(std::fmin(std::fmax(term_freq, 0.0), 1.0) * SCALE))) {
+    }
+
+    operator float() const {
+        return static_cast<float>(value_ * (1.0 / SCALE));
+    }
+
+private:
+    uint16_t value_ = 0;
+};
+
+#if defined(SEARCH_SERVER_TF_QUANTIZED)
+using TermFrequency = QuantizedTermFrequency;
+using RelevanceAccumulator = float;
+inline constexpr double RELEVANCE_EPSILON = 5e-4;
+#elif defined(SEARCH_SERVER_TF_FLOAT)
+using TermFrequency = float;
+using RelevanceAccumulator = float;
+inline constexpr double RELEVANCE_EPSILON = 1e-5;
+#else
+using TermFrequency = double;
+using RelevanceAccumulator = double;
+inline constexpr double RELEVANCE_EPSILON = 1e-6;
+#endif
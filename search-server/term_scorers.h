@@ -0,0 +1,65 @@
+#pragma once
+
+#include <climits>
+
+#include "search_options.h"
+
+// Scorers give the contribution of one query term to the relevance of a document.
+// A scorer is made once per term of a query, so the posting loop is a plain
+// multiply-add without branches on the ranking model
+
+// Bounds of a term over its postings, kept up to date on AddDocument. They are not
+// tightened on RemoveDocument, so they stay valid upper bounds but may be loose
+struct TermScoreBound {
+    double max_term_freq = 0.0;
+    int max_term_count = 0;
+    int min_document_length = INT_MAX;
+};
+
+class TfIdfScorer {
+public:
+    explicit TfIdfScorer(double inverse_document_freq)
+        : inverse_document_freq_(inverse_document_freq) {
+    }
+
+    double operator()(double term_freq, int /*document_length*/) const {
+        return term_freq * inverse_document_freq_;
+    }
+
+    double GetUpperBound(const TermScoreBound& bound) const {
+        return bound.max_term_freq * inverse_document_freq_;
+    }
+
+private:
+    double inverse_document_freq_;
+};
+
+// term_freq is the share of the term among the document words, so the occurrence count
+// is term_freq * document_length
+class Bm25Scorer {
+public:
+    Bm25Scorer(double inverse_document_freq, const Bm25Parameters& parameters, double average_length)
+        : weight_(inverse_document_freq * (parameters.k1 + 1.0))
+        , constant_norm_(parameters.k1 * (1.0 - parameters.b))
+        , length_norm_(average_length > 0.0 ? parameters.k1 * parameters.b / average_length : 0.0) {
+    }
+
+    double operator()(double term_freq, int document_length) const {
+        const double term_count = term_freq * document_length;
+        return weight_ * term_count / (term_count + constant_norm_ + length_norm_ * document_length);
+    }
+
+    // The score grows with the count and falls with the length
+    double GetUpperBound(const TermScoreBound& bound) const {
+        if (bound.max_term_count == 0) {
+            return 0.0;
+        }
+        const double term_count = bound.max_term_count;
+        return weight_ * term_count / (term_count + constant_norm_ + length_norm_ * bound.min_document_length);
+    }
+
+private:
+    double weight_;
+    double constant_norm_;
+    double length_norm_;
+};
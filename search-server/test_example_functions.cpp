@@ -1,9 +1,529 @@
 #include "test_example_functions.h"
-//#include "search_server.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include "corpus_loader.h"
+#include "distributed_search.h"
+#include "durable_search_server.h"
+#include "sharded_search_server.h"
+
+using namespace std;
 
 void AddDocument(SearchServer& search_server, int document_id, const std::string& document, DocumentStatus status,
                  const std::vector<int>& ratings) {
     search_server.AddDocument(document_id, document, status, ratings);
 }
+
+namespace {
+
+template <typename Value>
+ostream& operator<<(ostream& out, const vector<Value>& values) {
+    out << '[';
+    bool first = true;
+    for (const Value& value : values) {
+        out << (first ? ""s : ", "s) << value;
+        first = false;
+    }
+    return out << ']';
+}
+
+ostream& operator<<(ostream& out, DocumentStatus status) {
+    return out << "DocumentStatus("s << static_cast<int>(status) << ")"s;
+}
+
+template <typename Lhs, typename Rhs>
+void AssertEqualImpl(const Lhs& lhs, const Rhs& rhs, const string& lhs_text, const string& rhs_text,
+                     const string& file, int line, const string& hint) {
+    if (lhs != rhs) {
+        cerr << file << "("s << line << "): ASSERT_EQUAL("s << lhs_text << ", "s << rhs_text << ") failed: "s
+             << lhs << " != "s << rhs << "."s;
+        if (!hint.empty()) {
+            cerr << " Hint: "s << hint;
+        }
+        cerr << endl;
+        abort();
+    }
+}
+
+void AssertImpl(bool value, const string& text, const string& file, int line, const string& hint) {
+    if (!value) {
+        cerr << file << "("s << line << "): ASSERT("s << text << ") failed."s;
+        if (!hint.empty()) {
+            cerr << " Hint: "s << hint;
+        }
+        cerr << endl;
+        abort();
+    }
+}
+
+#define ASSERT_EQUAL(lhs, rhs) AssertEqualImpl((lhs), (rhs), #lhs, #rhs, __FILE__, __LINE__, ""s)
+#define ASSERT_EQUAL_HINT(lhs, rhs, hint) AssertEqualImpl((lhs), (rhs), #lhs, #rhs, __FILE__, __LINE__, (hint))
+#define ASSERT(expr) AssertImpl(!!(expr), #expr, __FILE__, __LINE__, ""s)
+#define ASSERT_HINT(expr, hint) AssertImpl(!!(expr), #expr, __FILE__, __LINE__, (hint))
+
+template <typename Exception, typename Action>
+bool Throws(Action action) {
+    try {
+        action();
+    } catch (const Exception&) {
+        return true;
+    }
+    return false;
+}
+
+// Ids of the documents in the order found
+vector<int> GetIds(const vector<Document>& documents) {
+    vector<int> ids;
+    for (const Document& document : documents) {
+        ids.push_back(document.id);
+    }
+    return ids;
+}
+
+vector<int> GetSortedIds(const vector<Document>& documents) {
+    vector<int> ids = GetIds(documents);
+    sort(ids.begin(), ids.end());
+    return ids;
+}
+
+vector<string> ToStrings(const vector<string_view>& words) {
+    return {words.begin(), words.end()};
+}
+
+SearchOptions MakeAllModeOptions() {
+    SearchOptions options;
+    options.mode = QueryMode::ALL;
+    return options;
+}
+
+// A directory under the system temporary one, removed with its files by the destructor
+class TemporaryDirectory {
+public:
+    TemporaryDirectory() {
+        string path = (filesystem::temp_directory_path() / "search_server_test_XXXXXX"s).string();
+        if (mkdtemp(path.data()) == nullptr) {
+            throw runtime_error("Не удалось создать временный каталог"s);
+        }
+        path_ = path;
+    }
+
+    ~TemporaryDirectory() {
+        error_code error;
+        filesystem::remove_all(path_, error);
+    }
+
+    TemporaryDirectory(const TemporaryDirectory&) = delete;
+    TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+    const string& GetPath() const {
+        return path_;
+    }
+
+private:
+    string path_;
+};
+
+void TestAllModeAndPhrases() {
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "white cat and fancy collar"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "white dog"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(3, "cat white"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(4, "black cat"s, DocumentStatus::ACTUAL, {1});
+
+    const SearchOptions all = MakeAllModeOptions();
+    ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("white cat"s)), (vector<int>{1, 2, 3, 4}));
+    ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("white cat"s, all)), (vector<int>{1, 3}));
+    ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments(execution::par, "white cat"s, all)),
+                 (vector<int>{1, 3}));
+    ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("white cat -collar"s, all)), (vector<int>{3}));
+    ASSERT_HINT(search_server.FindTopDocuments("white cat parrot"s, all).empty(),
+                "a word no document has matches nothing in ALL mode"s);
+
+    //a phrase is required in any mode, its words in order and next to each other
+    ASSERT_EQUAL(GetIds(search_server.FindTopDocuments("\"white cat\""s)), (vector<int>{1}));
+    ASSERT_EQUAL(GetIds(search_server.FindTopDocuments(execution::par, "\"white cat\""s)), (vector<int>{1}));
+    ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("\"cat white\" dog"s)), (vector<int>{3}));
+    ASSERT_HINT(search_server.FindTopDocuments("\"white collar\""s).empty(), "the phrase words are apart"s);
+    //a stop word inside a phrase still takes its position
+    SearchServer with_stop_words("and"s);
+    with_stop_words.AddDocument(1, "cat and collar"s, DocumentStatus::ACTUAL, {1});
+    with_stop_words.AddDocument(2, "cat collar"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(GetIds(with_stop_words.FindTopDocuments("\"cat and collar\""s)), (vector<int>{1}));
+
+    const auto [phrase_words, phrase_status] = search_server.MatchDocument("\"white cat\""s, 1);
+    ASSERT_EQUAL(ToStrings(phrase_words), (vector<string>{"cat"s, "white"s}));
+    ASSERT_EQUAL(phrase_status, DocumentStatus::ACTUAL);
+    ASSERT(get<0>(search_server.MatchDocument("\"white cat\""s, 3)).empty());
+
+    ASSERT(Throws<invalid_argument>([&] { search_server.FindTopDocuments("\"white cat"s); }));
+    ASSERT(Throws<invalid_argument>([&] { search_server.FindTopDocuments("\"white -cat\""s); }));
+}
+
+void TestStatusAndRatingPredicates() {
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "cat"s, DocumentStatus::BANNED, {5});
+    search_server.AddDocument(3, "cat"s, DocumentStatus::ACTUAL, {9});
+    search_server.AddDocument(4, "cat"s, DocumentStatus::REMOVED, {7});
+
+    const auto check = [&](const vector<int>& status_ids, const vector<int>& rating_ids) {
+        //the predicates answered from the flat attributes agree with the ones called per document
+        ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("cat"s, StatusIs{DocumentStatus::ACTUAL})),
+                     status_ids);
+        ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("cat"s,
+                         [](int, DocumentStatus status, int) { return status == DocumentStatus::ACTUAL; })),
+                     status_ids);
+        ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments(execution::par, "cat"s, DocumentStatus::ACTUAL)),
+                     status_ids);
+        ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("cat"s, RatingAtLeast{5})), rating_ids);
+        ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("cat"s,
+                         [](int, DocumentStatus, int rating) { return rating >= 5; })),
+                     rating_ids);
+        ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments(execution::par, "cat"s, RatingAtLeast{5})),
+                     rating_ids);
+        ASSERT_EQUAL(search_server.FindTopDocuments("cat"s, AnyDocument{}).size(),
+                     static_cast<size_t>(search_server.GetDocumentCount()));
+    };
+    check({1, 3}, {2, 3, 4});
+    ASSERT_EQUAL(GetIds(search_server.FindTopDocuments("cat"s, [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 0;
+    })), (vector<int>{4, 2}));
+
+    //the slot of a removed document is reused, with the attributes of the new one
+    search_server.RemoveDocument(3);
+    search_server.AddDocument(1000000, "cat"s, DocumentStatus::ACTUAL, {2});
+    check({1, 1000000}, {2, 4});
+    ASSERT_EQUAL(search_server.GetDocumentStatus(1000000), DocumentStatus::ACTUAL);
+    ASSERT_EQUAL(search_server.GetDocumentRating(1000000), 2);
+}
+
+string FindLastSegment(const string& directory) {
+    string last;
+    for (const auto& entry : filesystem::directory_iterator(directory)) {
+        const string name = entry.path().filename().string();
+        if (name.rfind("wal-"s, 0) == 0 && (last.empty() || stoull(name.substr(4)) > stoull(last.substr(4)))) {
+            last = name;
+        }
+    }
+    return directory + "/"s + last;
+}
+
+void TestWalReplayAfterTornTail() {
+    TemporaryDirectory directory;
+    DurabilityOptions options;
+    options.checkpoint_log_bytes = 0;
+    {
+        SearchServer search_server(""s);
+        DurableSearchServer durable(search_server, directory.GetPath(), options);
+        durable.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {1, 2, 3});
+        durable.AddDocument(2, "black dog"s, DocumentStatus::BANNED, {4});
+        durable.AddDocument(3, "grey parrot"s, DocumentStatus::ACTUAL, {5});
+        durable.RemoveDocument(2);
+        durable.WaitDurable();
+    }
+    //a crash in the middle of a batch leaves a part of a record at the end of the segment
+    {
+        ofstream segment(FindLastSegment(directory.GetPath()), ios::binary | ios::app);
+        const char torn_record[] = {40, 0, 0, 0, 1, 2, 3, 4, 7, 0, 0};
+        segment.write(torn_record, sizeof(torn_record));
+    }
+    {
+        SearchServer search_server(""s);
+        DurableSearchServer durable(search_server, directory.GetPath(), options);
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+        ASSERT_EQUAL(search_server.GetDocumentText(1), "white cat"sv);
+        ASSERT_EQUAL(search_server.GetDocumentRating(1), 2);
+        ASSERT_EQUAL(search_server.GetDocumentStatus(3), DocumentStatus::ACTUAL);
+        ASSERT(Throws<out_of_range>([&] { search_server.GetDocumentText(2); }));
+        //writing goes on after the torn tail, not behind it
+        durable.AddDocument(4, "white parrot"s, DocumentStatus::ACTUAL, {6});
+        durable.WaitDurable();
+    }
+    {
+        //a damaged last record is dropped as well
+        ofstream segment(FindLastSegment(directory.GetPath()), ios::binary | ios::app);
+        const char damaged_record[] = {2, 0, 0, 0, 0, 0, 0, 0, 1, 1};
+        segment.write(damaged_record, sizeof(damaged_record));
+    }
+    {
+        SearchServer search_server(""s);
+        DurableSearchServer durable(search_server, directory.GetPath(), options);
+        ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("white parrot"s)), (vector<int>{1, 3, 4}));
+        durable.Checkpoint();
+    }
+    {
+        SearchServer search_server(""s);
+        DurableSearchServer durable(search_server, directory.GetPath(), options);
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 3);
+    }
+}
+
+void TestCorpusLoaderMalformedLines() {
+    TemporaryDirectory directory;
+    const string tsv_path = directory.GetPath() + "/corpus.tsv"s;
+    {
+        ofstream out(tsv_path, ios::binary);
+        out << "1\tACTUAL\t1 2 3\twhite cat\n"s
+            << "x\tACTUAL\t1\tbad id\n"s
+            << "2\tUNKNOWN\t1\tbad status\n"s
+            << "3\tACTUAL\t1,a\tbad rating\n"s
+            << "4\n"s
+            << "\n"s
+            << "1\tBANNED\t5\tsame id again\n"s
+            << "5\tBANNED\t4, 6\tblack dog\r\n"s
+            << "6\t2\t\tgrey \x01 parrot\n"s
+            << "7\t3\t7\tno line end"s;
+    }
+    SearchServer search_server(""s);
+    //tiny chunks, so that the lines are split over many of them
+    const CorpusLoadResult tsv_result = LoadCorpus(search_server, tsv_path, {CorpusFormat::TSV, 16, 2, 2});
+    ASSERT_EQUAL(tsv_result.added_documents, 3u);
+    ASSERT_EQUAL_HINT(tsv_result.rejected_records, 6u,
+                      "bad id, status, rating, missing fields, a repeated id and a control character"s);
+    ASSERT_EQUAL(search_server.GetDocumentText(1), "white cat"sv);
+    ASSERT_EQUAL(search_server.GetDocumentRating(1), 2);
+    ASSERT_EQUAL(search_server.GetDocumentText(5), "black dog"sv);
+    ASSERT_EQUAL(search_server.GetDocumentStatus(5), DocumentStatus::BANNED);
+    ASSERT_EQUAL(search_server.GetDocumentRating(5), 5);
+    ASSERT_EQUAL(search_server.GetDocumentStatus(7), DocumentStatus::REMOVED);
+
+    const string json_path = directory.GetPath() + "/corpus.jsonl"s;
+    {
+        ofstream out(json_path, ios::binary);
+        out << R"({"id": 10, "status": "ACTUAL", "ratings": [1, 2], "text": "white \"cat\" кот"})" "\n"
+            << R"({"id": 11, "status": "ACTUAL", "ratings": [1], "text": "unterminated})" "\n"
+            << R"({"id": 12, "status": "ACTUAL", "ratings": [1,], "text": "bad ratings"})" "\n"
+            << R"({"id": 13, "text": "no status", "color": "red"})" "\n"
+            << R"({"id": 14, "status": 1, "text": "trailing"} x)" "\n"
+            << R"({"id": 15, "status": 2, "ratings": [], "text": "no ratings"})" "\n"
+            << R"({"status": "ACTUAL", "text": "no id"})" "\n";
+    }
+    SearchServer json_server(""s);
+    const CorpusLoadResult json_result = LoadCorpus(json_server, json_path, {CorpusFormat::JSONL, 32, 1, 1});
+    ASSERT_EQUAL(json_result.added_documents, 2u);
+    ASSERT_EQUAL(json_result.rejected_records, 5u);
+    ASSERT_EQUAL(json_server.GetDocumentText(10), "white \"cat\" кот"sv);
+    ASSERT_EQUAL(json_server.GetDocumentStatus(15), DocumentStatus::BANNED);
+    ASSERT_EQUAL(json_server.GetDocumentRating(15), 0);
+
+    ASSERT(Throws<runtime_error>([&] { LoadCorpus(search_server, directory.GetPath() + "/missing.tsv"s); }));
+}
+
+void TestTermExpansion() {
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "cats and dogs"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(3, "catalog"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(4, "dog"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(5, "пушистый кот"s, DocumentStatus::ACTUAL, {1});
+
+    ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("cat*"s)), (vector<int>{1, 2, 3}));
+    ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("cat* -catalog"s)), (vector<int>{1, 2}));
+    ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("dog -cat*"s)), (vector<int>{4}));
+    ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("cot~"s)), (vector<int>{1}));
+    ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("cot~2"s)), (vector<int>{1, 2, 4}));
+    ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("кит~ пушыстый~"s)), (vector<int>{5}));
+    ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("ПУШ*"s)), (vector<int>{5}));
+    //in ALL mode one word of every expansion is required
+    ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("cat* dog*"s, MakeAllModeOptions())),
+                 (vector<int>{2}));
+    ASSERT(search_server.FindTopDocuments("zebra*"s).empty());
+
+    const auto [words, status] = search_server.MatchDocument("cat* dog~"s, 2);
+    ASSERT_EQUAL(ToStrings(words), (vector<string>{"cats"s, "dogs"s}));
+
+    //the words of removed documents are not expanded to
+    search_server.RemoveDocument(3);
+    ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments("cat*"s)), (vector<int>{1, 2}));
+
+    ASSERT(Throws<invalid_argument>([&] { search_server.FindTopDocuments("cat~3"s); }));
+    ASSERT(Throws<invalid_argument>([&] { search_server.FindTopDocuments("*"s); }));
+    ASSERT(Throws<invalid_argument>([&] { search_server.FindTopDocuments("\"cat* dog\""s); }));
+}
+
+void TestFacets() {
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "white dog"s, DocumentStatus::ACTUAL, {4});
+    search_server.AddDocument(3, "black cat"s, DocumentStatus::BANNED, {5});
+    search_server.AddDocument(4, "grey cat"s, DocumentStatus::REMOVED, {8});
+    search_server.AddDocument(5, "white cat"s, DocumentStatus::IRRELEVANT, {-2});
+    search_server.AddDocument(6, "parrot"s, DocumentStatus::ACTUAL, {3});
+
+    const vector<int> rating_bounds = {0, 5};
+    const FacetedSearchResult result = search_server.FindTopDocumentsWithFacets("cat -grey"s, rating_bounds);
+    ASSERT_EQUAL(GetIds(result.documents), (vector<int>{1}));
+    ASSERT_EQUAL((vector<int>(result.facets.status_counts.begin(), result.facets.status_counts.end())),
+                 (vector<int>{1, 1, 1, 0}));
+    //(-inf, 0), [0, 5), [5, +inf)
+    ASSERT_EQUAL(result.facets.rating_counts, (vector<int>{1, 1, 1}));
+
+    //the facets count every match, the documents follow the predicate
+    const FacetedSearchResult rated = search_server.FindTopDocumentsWithFacets(
+        "white cat"s, {}, SearchOptions{}, RatingAtLeast{4});
+    ASSERT_EQUAL(GetSortedIds(rated.documents), (vector<int>{2, 3, 4}));
+    ASSERT_EQUAL(rated.facets.rating_counts, (vector<int>{5}));
+    const FacetedSearchResult parallel = search_server.FindTopDocumentsWithFacets(
+        execution::par, "white cat"s, rating_bounds, MakeAllModeOptions(), StatusIs{DocumentStatus::ACTUAL});
+    ASSERT_EQUAL(GetIds(parallel.documents), (vector<int>{1}));
+    ASSERT_EQUAL((vector<int>(parallel.facets.status_counts.begin(), parallel.facets.status_counts.end())),
+                 (vector<int>{1, 1, 0, 0}));
+    ASSERT_EQUAL(parallel.facets.rating_counts, (vector<int>{1, 1, 0}));
+
+    ASSERT(Throws<invalid_argument>([&] { search_server.FindTopDocumentsWithFacets("cat"s, {5, 0}); }));
+}
+
+void TestPreparedQueries() {
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(3, "white cat dog"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(4, "cat white dog"s, DocumentStatus::BANNED, {1});
+    search_server.AddDocument(5, "catalog dogs"s, DocumentStatus::ACTUAL, {1});
+
+    const SearchServer::PreparedQuery all_words = search_server.PrepareQuery("cat dog"s, MakeAllModeOptions());
+    ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments(all_words)), (vector<int>{1, 3}));
+    ASSERT(get<0>(search_server.MatchDocument(all_words, 2)).empty());
+    ASSERT_EQUAL(ToStrings(get<0>(search_server.MatchDocument(all_words, 1))), (vector<string>{"cat"s, "dog"s}));
+
+    //a document matches words exactly when the search finds it, whatever the predicate
+    const auto check_agreement = [&search_server](const SearchServer::PreparedQuery& prepared_query) {
+        const vector<int> found_ids = GetSortedIds(search_server.FindTopDocuments(prepared_query, AnyDocument{}));
+        vector<int> matched_ids;
+        for (const int document_id : search_server) {
+            if (!get<0>(search_server.MatchDocument(prepared_query, document_id)).empty()) {
+                matched_ids.push_back(document_id);
+            }
+        }
+        ASSERT_EQUAL_HINT(matched_ids, found_ids, string(prepared_query.GetText()));
+    };
+    for (const string& text : {"cat dog"s, "ca* dog~"s, "\"white cat\" dog"s, "cat -white"s, "cat* -dog*"s}) {
+        check_agreement(search_server.PrepareQuery(text));
+        check_agreement(search_server.PrepareQuery(text, MakeAllModeOptions()));
+    }
+
+    //executed after the index has changed, the words are resolved again
+    search_server.AddDocument(6, "dog cat"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(GetSortedIds(search_server.FindTopDocuments(all_words)), (vector<int>{1, 3, 6}));
+    check_agreement(all_words);
+    ASSERT(Throws<invalid_argument>([&] {
+        SearchServer other(""s);
+        other.FindTopDocuments(all_words);
+    }));
+}
+
+void TestDistributedSearchOptions() {
+    TemporaryDirectory directory;
+    const string address = "unix:"s + directory.GetPath() + "/worker.sock"s;
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, {{"title"sv, "cat"sv}, {"body"sv, "dog dog parrot"sv}}, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, {{"title"sv, "dog"sv}, {"body"sv, "cat cat parrot"sv}}, DocumentStatus::ACTUAL, {2});
+    search_server.AddDocument(3, {{"title"sv, "parrot"sv}, {"body"sv, "fish"sv}}, DocumentStatus::ACTUAL, {3});
+    SearchWorker worker(search_server, address);
+    thread serving([&worker] { worker.Serve(); });
+
+    SearchOptions options;
+    options.field_weights = {{"title"s, 5.0}};
+    {
+        SearchCoordinator coordinator({address}, chrono::milliseconds(5000));
+        //the field weights reach the worker and change the order
+        const DistributedSearchResult result = coordinator.FindTopDocuments("cat"s, options, StatusIs{});
+        ASSERT(result.IsComplete());
+        ASSERT_EQUAL(GetIds(result.documents), GetIds(search_server.FindTopDocuments("cat"s, options)));
+        ASSERT_EQUAL(GetIds(result.documents), (vector<int>{1, 2}));
+        ASSERT_EQUAL(GetIds(coordinator.FindTopDocuments("cat"s).documents), (vector<int>{2, 1}));
+        options.min_tier_recall = 2.0;
+        ASSERT(Throws<invalid_argument>([&] { coordinator.FindTopDocuments("cat"s, options, StatusIs{}); }));
+        ASSERT(Throws<invalid_argument>([&] {
+            coordinator.AddDocument(4, "cat"s, static_cast<DocumentStatus>(DOCUMENT_STATUS_COUNT), {1});
+        }));
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 3);
+    }
+    worker.Stop();
+    serving.join();
+}
+
+void TestShardedSearch() {
+    const vector<string> texts = {"white cat"s, "black dog"s, "white dog with a collar"s, "grey parrot"s,
+                                  "black cat and white dog"s, "cat"s, "dog"s};
+    SearchServer search_server("and with"s);
+    ShardedSearchServer sharded("and with"s, 3);
+    for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+        search_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id});
+        sharded.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id});
+    }
+    sharded.Flush();
+    ASSERT_EQUAL(sharded.GetDocumentCount(), search_server.GetDocumentCount());
+    for (const string& query : {"white cat"s, "dog -black"s, "parrot collar"s}) {
+        const vector<Document> expected = search_server.FindTopDocuments(query);
+        const vector<Document> found = sharded.FindTopDocuments(query);
+        ASSERT_EQUAL_HINT(GetIds(found), GetIds(expected), query);
+        for (size_t i = 0; i < found.size(); ++i) {
+            ASSERT_HINT(abs(found[i].relevance - expected[i].relevance) < RELEVANCE_EPSILON, query);
+        }
+    }
+
+    //searches from several threads while documents are added meanwhile
+    vector<thread> searchers;
+    for (int i = 0; i < 4; ++i) {
+        searchers.emplace_back([&sharded] {
+            for (int j = 0; j < 50; ++j) {
+                ASSERT(!sharded.FindTopDocuments("white cat"s).empty());
+            }
+        });
+    }
+    for (int id = 100; id < 300; ++id) {
+        sharded.AddDocument(id, "white cat number "s + to_string(id), DocumentStatus::ACTUAL, {1});
+    }
+    for (thread& searcher : searchers) {
+        searcher.join();
+    }
+    sharded.Flush();
+    ASSERT_EQUAL(sharded.GetDocumentCount(), static_cast<int>(texts.size()) + 200);
+
+    ASSERT(Throws<invalid_argument>([] { ShardedSearchServer("in\x01valid"s, 2); }));
+    ASSERT(Throws<invalid_argument>([&sharded] { sharded.FindTopDocuments("cat --dog"s); }));
+}
+
+void TestParallelMatchDocument() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "white cat and black dog"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "black cat"s, DocumentStatus::BANNED, {2});
+    search_server.AddDocument(3, "white parrot"s, DocumentStatus::ACTUAL, {3});
+    for (const string& query : {"cat dog"s, "cat unknown"s, "cat -dog"s, "cat -unknown"s, "\"black cat\" dog"s,
+                                "\"white cat\""s, "ca* parrot~"s, "unknown"s}) {
+        for (const int document_id : search_server) {
+            const auto [sequential_words, sequential_status] = search_server.MatchDocument(query, document_id);
+            const auto [parallel_words, parallel_status] = search_server.MatchDocument(execution::par, query, document_id);
+            ASSERT_EQUAL_HINT(ToStrings(parallel_words), ToStrings(sequential_words), query);
+            ASSERT_EQUAL(parallel_status, sequential_status);
+        }
+    }
+    ASSERT(Throws<out_of_range>([&] { search_server.MatchDocument(execution::par, "cat"s, 4); }));
+    ASSERT(Throws<invalid_argument>([&] { search_server.MatchDocument(execution::par, "cat --dog"s, 1); }));
+}
+
+}  // namespace
+
+void TestSearchServer() {
+    TestAllModeAndPhrases();
+    TestStatusAndRatingPredicates();
+    TestWalReplayAfterTornTail();
+    TestCorpusLoaderMalformedLines();
+    TestTermExpansion();
+    TestFacets();
+    TestPreparedQueries();
+    TestParallelMatchDocument();
+    TestDistributedSearchOptions();
+    TestShardedSearch();
+}
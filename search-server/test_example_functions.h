@@ -4,3 +4,6 @@
 
 void AddDocument(SearchServer& search_server, int document_id, const std::string& document, DocumentStatus status,
             const std::vector<int>& ratings);
+
+// Assertion-style tests of the search server and the code around it; aborts on the first failure
+void TestSearchServer();
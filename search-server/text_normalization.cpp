@@ -0,0 +1,268 @@
+#include "text_normalization.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+bool IsContinuation(unsigned char byte) {
+    return (byte & 0xC0) == 0x80;
+}
+
+//a continuation byte counts as one character, so a scan started inside a character
+//does not jump over the separator after it
+size_t GetCharacterLength(unsigned char lead) {
+    if (lead < 0xC0) {
+        return 1;
+    }
+    return lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+}
+
+bool IsUnicodeSpace(uint32_t code_point) {
+    return code_point == 0x85 || code_point == 0xA0 || (code_point >= 0x2000 && code_point <= 0x200A)
+        || code_point == 0x2028 || code_point == 0x2029 || code_point == 0x202F
+        || code_point == 0x205F || code_point == 0x3000;
+}
+
+//two-byte capitals only, so the length does not change
+uint32_t FoldCase(uint32_t code_point) {
+    if (code_point >= 0xC0 && code_point <= 0xDE && code_point != 0xD7) {
+        return code_point + 0x20;
+    }
+    if (code_point >= 0x400 && code_point <= 0x40F) {
+        return code_point + 0x50;
+    }
+    if (code_point >= 0x410 && code_point <= 0x42F) {
+        return code_point + 0x20;
+    }
+    return code_point;
+}
+
+//checks and normalizes the character at text[pos] into out[pos...]; returns its length, 0 if invalid
+size_t NormalizeCharacter(string_view text, size_t pos, char* out) {
+    const unsigned char lead = text[pos];
+    if (lead < 0x80) {
+        if (lead < 0x20) {
+            return 0;
+        }
+        out[pos] = lead >= 'A' && lead <= 'Z' ? static_cast<char>(lead + ('a' - 'A')) : static_cast<char>(lead);
+        return 1;
+    }
+    if (lead < 0xC2 || lead > 0xF4) {
+        return 0;
+    }
+    const size_t length = GetCharacterLength(lead);
+    if (text.size() - pos < length) {
+        return 0;
+    }
+    uint32_t code_point = lead & (0x7F >> length);
+    for (size_t i = 1; i < length; ++i) {
+        const unsigned char byte = text[pos + i];
+        if (!IsContinuation(byte)) {
+            return 0;
+        }
+        code_point = (code_point << 6) | (byte & 0x3F);
+    }
+    //overlong forms, surrogates and code points above U+10FFFF
+    if ((length == 3 && (code_point < 0x800 || (code_point >= 0xD800 && code_point <= 0xDFFF)))
+        || (length == 4 && (code_point < 0x10000 || code_point > 0x10FFFF))) {
+        return 0;
+    }
+    if (IsUnicodeSpace(code_point)) {
+        for (size_t i = 0; i < length; ++i) {
+            out[pos + i] = ' ';
+        }
+    } else if (length == 2) {
+        code_point = FoldCase(code_point);
+        out[pos] = static_cast<char>(0xC0 | (code_point >> 6));
+        out[pos + 1] = static_cast<char>(0x80 | (code_point & 0x3F));
+    } else {
+        for (size_t i = 0; i < length; ++i) {
+            out[pos + i] = text[pos + i];
+        }
+    }
+    return length;
+}
+
+//length of the separator at text[pos], 0 for a letter or digit: ASCII other than
+//letters and digits, U+0080-U+00BF, × and ÷, general and CJK punctuation, BOM
+size_t GetSeparatorLength(string_view text, size_t pos) {
+    const unsigned char lead = text[pos];
+    if (lead < 0x80) {
+        const bool is_alphanumeric = (lead >= '0' && lead <= '9') || (lead >= 'a' && lead <= 'z')
+            || (lead >= 'A' && lead <= 'Z');
+        return is_alphanumeric ? 0 : 1;
+    }
+    const size_t rest = text.size() - pos;
+    const unsigned char second = rest > 1 ? text[pos + 1] : 0;
+    if ((lead == 0xC2 && IsContinuation(second))
+        || (lead == 0xC3 && (second == 0x97 || second == 0xB7))) {
+        return 2;
+    }
+    if (rest > 2 && ((lead == 0xE2 && (second == 0x80 || second == 0x81)) || (lead == 0xE3 && second == 0x80)
+                     || (lead == 0xEF && second == 0xBB && static_cast<unsigned char>(text[pos + 2]) == 0xBF))) {
+        return 3;
+    }
+    return 0;
+}
+
+#ifdef __SSE2__
+
+const size_t BLOCK_SIZE = 16;
+
+//bytes are compared as signed: the range must not cross 0x7F/0x80
+__m128i IsInRange(__m128i bytes, char low, char high) {
+    return _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(static_cast<char>(low - 1))),
+                         _mm_cmplt_epi8(bytes, _mm_set1_epi8(static_cast<char>(high + 1))));
+}
+
+__m128i Load(const char* block) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+}
+
+//normalizes a block of ASCII and Cyrillic two-byte letters; returns the bytes done:
+//15 if the block ends with a lead byte, 0 if it holds anything else
+size_t NormalizeBlock(const char* block, char* out) {
+    const __m128i bytes = Load(block);
+    const __m128i is_ascii = _mm_cmpgt_epi8(bytes, _mm_set1_epi8(-1));
+    if (_mm_movemask_epi8(_mm_and_si128(is_ascii, _mm_cmplt_epi8(bytes, _mm_set1_epi8(0x20)))) != 0) {
+        return 0;
+    }
+    const __m128i latin_capitals = IsInRange(bytes, 'A', 'Z');
+    __m128i folded = _mm_add_epi8(bytes, _mm_and_si128(latin_capitals, _mm_set1_epi8(0x20)));
+    const int non_ascii_mask = _mm_movemask_epi8(bytes);
+    if (non_ascii_mask == 0) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), folded);
+        return BLOCK_SIZE;
+    }
+
+    const __m128i d0 = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(0xD0)));
+    const __m128i d1 = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(0xD1)));
+    const int lead_mask = _mm_movemask_epi8(_mm_or_si128(d0, d1));
+    //0x80-0xBF
+    const int continuation_mask = _mm_movemask_epi8(_mm_cmplt_epi8(bytes, _mm_set1_epi8(static_cast<char>(0xC0))));
+    //every D0/D1 is followed by one continuation byte, and there are no other non-ASCII bytes
+    if ((lead_mask | continuation_mask) != non_ascii_mask || continuation_mask != ((lead_mask << 1) & 0xFFFF)) {
+        return 0;
+    }
+    //after D0: 80-8F (Ѐ-Џ) go to D1 90-9F, 90-9F (А-П) to D0 B0-BF, A0-AF (Р-Я) to D1 80-8F
+    const __m128i after_d0 = _mm_slli_si128(d0, 1);
+    const __m128i to_d1_plus = _mm_and_si128(after_d0, _mm_cmplt_epi8(bytes, _mm_set1_epi8(static_cast<char>(0x90))));
+    const __m128i to_d0 = _mm_and_si128(after_d0, IsInRange(bytes, static_cast<char>(0x90), static_cast<char>(0x9F)));
+    const __m128i to_d1_minus = _mm_and_si128(after_d0, IsInRange(bytes, static_cast<char>(0xA0), static_cast<char>(0xAF)));
+    const __m128i continuation_delta = _mm_or_si128(
+        _mm_or_si128(_mm_and_si128(to_d1_plus, _mm_set1_epi8(0x10)), _mm_and_si128(to_d0, _mm_set1_epi8(0x20))),
+        _mm_and_si128(to_d1_minus, _mm_set1_epi8(static_cast<char>(0xE0))));
+    const __m128i lead_delta = _mm_and_si128(_mm_srli_si128(_mm_or_si128(to_d1_plus, to_d1_minus), 1),
+                                             _mm_set1_epi8(1));
+    folded = _mm_add_epi8(folded, _mm_add_epi8(continuation_delta, lead_delta));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), folded);
+    //the continuation of the last lead is in the next block
+    return (lead_mask & 0x8000) != 0 ? BLOCK_SIZE - 1 : BLOCK_SIZE;
+}
+
+//bit i is set if block[i] is an ASCII separator; -1 if the block has a lead byte of a
+//Unicode separator and has to be scanned character by character
+int GetSeparatorMask(const char* block) {
+    const __m128i bytes = Load(block);
+    __m128i separator_leads = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(0xC2)));
+    for (const unsigned char lead : {0xC3, 0xE2, 0xE3, 0xEF}) {
+        separator_leads = _mm_or_si128(separator_leads, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(lead))));
+    }
+    if (_mm_movemask_epi8(separator_leads) != 0) {
+        return -1;
+    }
+    const __m128i alphanumeric = _mm_or_si128(IsInRange(bytes, '0', '9'),
+                                              _mm_or_si128(IsInRange(bytes, 'a', 'z'), IsInRange(bytes, 'A', 'Z')));
+    const __m128i is_ascii = _mm_cmpgt_epi8(bytes, _mm_set1_epi8(-1));
+    return _mm_movemask_epi8(_mm_andnot_si128(alphanumeric, is_ascii));
+}
+
+#endif
+
+} // namespace
+
+bool NormalizeText(string_view text, char* out) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+#ifdef __SSE2__
+        if (text.size() - pos >= BLOCK_SIZE) {
+            const size_t done = NormalizeBlock(text.data() + pos, out + pos);
+            if (done > 0) {
+                pos += done;
+                continue;
+            }
+        }
+#endif
+        const size_t length = NormalizeCharacter(text, pos, out);
+        if (length == 0) {
+            return false;
+        }
+        pos += length;
+    }
+    return true;
+}
+
+size_t FindWordBegin(string_view text, size_t pos) {
+    while (pos < text.size()) {
+#ifdef __SSE2__
+        if (text.size() - pos >= BLOCK_SIZE) {
+            const int separator_mask = GetSeparatorMask(text.data() + pos);
+            if (separator_mask >= 0) {
+                const int word_mask = ~separator_mask & 0xFFFF;
+                if (word_mask != 0) {
+                    return pos + __builtin_ctz(word_mask);
+                }
+                pos += BLOCK_SIZE;
+                continue;
+            }
+        }
+#endif
+        const size_t separator_length = GetSeparatorLength(text, pos);
+        if (separator_length == 0) {
+            return pos;
+        }
+        pos += separator_length;
+    }
+    return text.size();
+}
+
+size_t FindWordEnd(string_view text, size_t pos) {
+    while (pos < text.size()) {
+#ifdef __SSE2__
+        if (text.size() - pos >= BLOCK_SIZE) {
+            const int separator_mask = GetSeparatorMask(text.data() + pos);
+            if (separator_mask >= 0) {
+                if (separator_mask != 0) {
+                    return pos + __builtin_ctz(separator_mask);
+                }
+                pos += BLOCK_SIZE;
+                continue;
+            }
+        }
+#endif
+        if (GetSeparatorLength(text, pos) > 0) {
+            return pos;
+        }
+        pos += GetCharacterLength(text[pos]);
+    }
+    return text.size();
+}
+
+char32_t DecodeCharacter(string_view text, size_t& pos) {
+    const unsigned char lead = text[pos];
+    //a truncated character is cut short rather than read past the end
+    const size_t length = min(GetCharacterLength(lead), text.size() - pos);
+    char32_t code_point = length == 1 ? lead : lead & (0x7F >> length);
+    for (size_t i = 1; i < length; ++i) {
+        code_point = (code_point << 6) | (static_cast<unsigned char>(text[pos + i]) & 0x3F);
+    }
+    pos += length;
+    return code_point;
+}
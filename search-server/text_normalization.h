@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Documents and queries go through the same normalization, so "Поиск" finds "поиск".
+// Capital Latin and Cyrillic letters (A-Z, À-Þ, А-Я, Ё, Ѐ-Џ) become small ones and
+// Unicode spaces become ASCII spaces. Every character keeps its length in bytes, so
+// an offset into the normalized text is an offset into the original one.
+// Writes text.size() bytes to out. Returns false for invalid UTF-8 or a character
+// with a code from 0 to 31; out is unspecified then.
+// Blocks of ASCII and of two-byte Cyrillic letters are done 16 bytes at a time with SSE2
+bool NormalizeText(std::string_view text, char* out);
+
+// Words are the runs of characters between spaces and punctuation, ASCII or Unicode.
+// text must be normalized
+size_t FindWordBegin(std::string_view text, size_t pos);
+size_t FindWordEnd(std::string_view text, size_t pos);
+
+// The code point of the character at text[pos]; pos moves past it. text must be valid
+// UTF-8, normalized text for one. Edit distances count code points, not bytes
+char32_t DecodeCharacter(std::string_view text, size_t& pos);
+
+// Calls action(offset, length) for the words of normalized text in order
+template <typename Action>
+void ForEachWord(std::string_view text, Action action) {
+    size_t begin = FindWordBegin(text, 0);
+    while (begin < text.size()) {
+        const size_t end = FindWordEnd(text, begin);
+        action(begin, end - begin);
+        begin = FindWordBegin(text, end);
+    }
+}
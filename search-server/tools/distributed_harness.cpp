@@ -0,0 +1,163 @@
+// Runs SearchWorker processes on local sockets behind a SearchCoordinator and checks the
+// merged results against a single SearchServer: with all workers up, with one worker
+// stalled (SIGSTOP), after it resumes and with one worker killed. A partial result must
+// come back within the timeout and equal the ranking of the documents of the workers
+// that answered. Prints every phase and fails if one of them does not hold.
+//
+// Usage: distributed_harness [workers] [documents] [queries] [timeout_ms]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../distributed_search.h"
+#include "../query_generator.h"
+#include "../search_server.h"
+
+using namespace std;
+
+namespace {
+
+struct Corpus {
+    vector<string> documents;
+    vector<string> queries;
+};
+
+// Serves until killed; never returns
+[[noreturn]] void RunWorker(const string& address) {
+    try {
+        SearchServer search_server(""s);
+        SearchWorker worker(search_server, address);
+        worker.Serve();
+    } catch (const exception& error) {
+        cerr << "worker "s << address << ": "s << error.what() << endl;
+    }
+    _exit(1);
+}
+
+// Adds the documents of the workers not in down_workers, as the coordinator routes them
+void FillReference(SearchServer& reference, const Corpus& corpus, size_t worker_count,
+                   const vector<size_t>& down_workers) {
+    for (size_t id = 0; id < corpus.documents.size(); ++id) {
+        if (find(down_workers.begin(), down_workers.end(), id % worker_count) == down_workers.end()) {
+            //the rating is the id, so that documents of equal relevance are ranked the same everywhere
+            reference.AddDocument(static_cast<int>(id), corpus.documents[id], DocumentStatus::ACTUAL,
+                                  {static_cast<int>(id)});
+        }
+    }
+}
+
+bool CheckPhase(const string& name, SearchCoordinator& coordinator, const Corpus& corpus, size_t worker_count,
+                const vector<size_t>& down_workers, chrono::milliseconds timeout) {
+    SearchServer reference(""s);
+    FillReference(reference, corpus, worker_count, down_workers);
+    const size_t expected_workers = worker_count - down_workers.size();
+    size_t mismatches = 0;
+    size_t wrong_counts = 0;
+    chrono::duration<double> slowest{0};
+    for (const string& query : corpus.queries) {
+        const auto start = chrono::steady_clock::now();
+        const DistributedSearchResult result = coordinator.FindTopDocuments(query);
+        slowest = max(slowest, chrono::duration<double>(chrono::steady_clock::now() - start));
+        if (result.responded_workers != expected_workers || result.total_workers != worker_count) {
+            ++wrong_counts;
+            continue;
+        }
+        const vector<Document> expected = reference.FindTopDocuments(query);
+        bool is_equal = expected.size() == result.documents.size();
+        for (size_t i = 0; is_equal && i < expected.size(); ++i) {
+            is_equal = expected[i].id == result.documents[i].id
+                && abs(expected[i].relevance - result.documents[i].relevance) < 1e-9;
+        }
+        mismatches += !is_equal;
+    }
+    //a search makes two round trips, each bounded by the timeout
+    const bool is_in_time = slowest < 2 * timeout + chrono::milliseconds(500);
+    const bool passed = mismatches == 0 && wrong_counts == 0 && is_in_time;
+    cout << name << ": "s << (passed ? "ok"s : "FAILED"s) << ", answering workers "s << expected_workers << "/"s
+         << worker_count << ", mismatched results "s << mismatches << ", wrong worker counts "s << wrong_counts
+         << ", slowest search "s << slowest.count() * 1000 << " ms"s << endl;
+    return passed;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const size_t worker_count = argc > 1 ? stoul(argv[1]) : 3;
+    const int document_count = argc > 2 ? stoi(argv[2]) : 3000;
+    const int query_count = argc > 3 ? stoi(argv[3]) : 100;
+    const chrono::milliseconds timeout(argc > 4 ? stoi(argv[4]) : 300);
+    if (worker_count < 2) {
+        cerr << "Usage: distributed_harness [workers >= 2] [documents] [queries] [timeout_ms]"s << endl;
+        return 1;
+    }
+
+    //workers are forked before the coordinator starts any thread
+    vector<string> addresses;
+    vector<pid_t> pids;
+    for (size_t i = 0; i < worker_count; ++i) {
+        addresses.push_back("unix:/tmp/distributed_harness_"s + to_string(getpid()) + "_"s + to_string(i) + ".sock"s);
+        const pid_t pid = fork();
+        if (pid == 0) {
+            RunWorker(addresses.back());
+        }
+        pids.push_back(pid);
+    }
+
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 1000, 8);
+    Corpus corpus;
+    for (int i = 0; i < document_count; ++i) {
+        corpus.documents.push_back(GenerateQuery(generator, dictionary, 30));
+    }
+    corpus.queries = GenerateQueries(generator, dictionary, query_count, 4);
+
+    bool passed = true;
+    try {
+        SearchCoordinator coordinator(addresses, timeout);
+        //the workers may still be binding their sockets
+        for (size_t id = 0; id < corpus.documents.size(); ++id) {
+            for (int attempt = 0;; ++attempt) {
+                try {
+                    coordinator.AddDocument(static_cast<int>(id), corpus.documents[id], DocumentStatus::ACTUAL,
+                                            {static_cast<int>(id)});
+                    break;
+                } catch (const runtime_error&) {
+                    if (attempt == 50) {
+                        throw;
+                    }
+                    this_thread::sleep_for(chrono::milliseconds(100));
+                }
+            }
+        }
+
+        passed = CheckPhase("all workers"s, coordinator, corpus, worker_count, {}, timeout) && passed;
+        kill(pids[0], SIGSTOP);
+        passed = CheckPhase("worker 0 stalled"s, coordinator, corpus, worker_count, {0}, timeout) && passed;
+        kill(pids[0], SIGCONT);
+        passed = CheckPhase("worker 0 resumed"s, coordinator, corpus, worker_count, {}, timeout) && passed;
+        kill(pids[1], SIGKILL);
+        waitpid(pids[1], nullptr, 0);
+        passed = CheckPhase("worker 1 killed"s, coordinator, corpus, worker_count, {1}, timeout) && passed;
+    } catch (const exception& error) {
+        cout << "error: "s << error.what() << endl;
+        passed = false;
+    }
+
+    for (size_t i = 0; i < worker_count; ++i) {
+        kill(pids[i], SIGKILL);
+        waitpid(pids[i], nullptr, 0);
+        unlink(addresses[i].substr(5).c_str());
+    }
+    cout << (passed ? "OK"s : "FAILED"s) << endl;
+    return passed ? 0 : 1;
+}
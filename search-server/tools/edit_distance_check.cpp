@@ -0,0 +1,208 @@
+// Checks the edit distances of fuzzy lookups on Latin and Cyrillic words: the matches of
+// TermDictionary::FindWithinDistance and SuggestionIndex::SuggestCorrections against plain
+// distances over code points, term~ queries and suggestions of SearchServer. Prints the
+// mismatches and fails if there are any.
+//
+// Usage: edit_distance_check [word_count] [pattern_count]
+
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../query_scratch.h"
+#include "../search_server.h"
+#include "../suggestion_index.h"
+#include "../term_dictionary.h"
+#include "../text_normalization.h"
+
+using namespace std;
+
+namespace {
+
+u32string Decode(string_view word) {
+    u32string letters;
+    for (size_t pos = 0; pos < word.size();) {
+        letters.push_back(DecodeCharacter(word, pos));
+    }
+    return letters;
+}
+
+//Levenshtein distance, with swaps of adjacent letters as one edit if allow_swaps
+int ComputeDistance(const u32string& lhs, const u32string& rhs, bool allow_swaps) {
+    vector<vector<int>> distances(lhs.size() + 1, vector<int>(rhs.size() + 1));
+    for (size_t i = 0; i <= lhs.size(); ++i) {
+        for (size_t j = 0; j <= rhs.size(); ++j) {
+            if (i == 0 || j == 0) {
+                distances[i][j] = static_cast<int>(i + j);
+                continue;
+            }
+            distances[i][j] = min({distances[i - 1][j] + 1, distances[i][j - 1] + 1,
+                                   distances[i - 1][j - 1] + (lhs[i - 1] == rhs[j - 1] ? 0 : 1)});
+            if (allow_swaps && i > 1 && j > 1 && lhs[i - 1] == rhs[j - 2] && lhs[i - 2] == rhs[j - 1]) {
+                distances[i][j] = min(distances[i][j], distances[i - 2][j - 2] + 1);
+            }
+        }
+    }
+    return distances[lhs.size()][rhs.size()];
+}
+
+//few letters, so that random words are often close to each other
+string GenerateWord(mt19937& generator) {
+    static const vector<string> letters = {"a"s, "b"s, "c"s, "а"s, "б"s, "в"s, "ё"s, "я"s};
+    string word;
+    const int length = uniform_int_distribution(1, 7)(generator);
+    for (int i = 0; i < length; ++i) {
+        word += letters[generator() % letters.size()];
+    }
+    return word;
+}
+
+deque<string> GenerateWords(mt19937& generator, int word_count) {
+    deque<string> words;
+    vector<string> sorted_words;
+    while (static_cast<int>(words.size()) < word_count) {
+        string word = GenerateWord(generator);
+        const auto it = lower_bound(sorted_words.begin(), sorted_words.end(), word);
+        if (it != sorted_words.end() && *it == word) {
+            continue;
+        }
+        sorted_words.insert(it, word);
+        words.push_back(move(word));
+    }
+    return words;
+}
+
+int CheckDictionary(int word_count, int pattern_count) {
+    mt19937 generator;
+    const deque<string> words = GenerateWords(generator, word_count);
+    TermDictionary dictionary;
+    for (const string& word : words) {
+        dictionary.Insert(word);
+    }
+
+    int mismatches = 0;
+    for (int i = 0; i < pattern_count; ++i) {
+        const string pattern = GenerateWord(generator);
+        const int max_edits = 1 + i % 2;
+        QueryScratch::Scope scratch;
+        pmr::vector<TermDictionary::Match> matches(QueryScratch::GetResource());
+        dictionary.FindWithinDistance(pattern, max_edits, matches);
+
+        vector<pair<int, int>> found;
+        for (const auto& match : matches) {
+            found.push_back({match.word_id, match.edits});
+        }
+        vector<pair<int, int>> expected;
+        for (size_t word_id = 0; word_id < words.size(); ++word_id) {
+            const int edits = ComputeDistance(Decode(pattern), Decode(words[word_id]), false);
+            if (edits <= max_edits) {
+                expected.push_back({static_cast<int>(word_id), edits});
+            }
+        }
+        sort(found.begin(), found.end());
+        if (found != expected) {
+            cout << "dictionary: "s << pattern << "~"s << max_edits << " finds "s << found.size()
+                 << " words instead of "s << expected.size() << endl;
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+//prefix_length 4 is shorter than many of the words, so that the deletes of the prefix only are checked too
+int CheckCorrections(int word_count, int pattern_count) {
+    mt19937 generator;
+    const deque<string> words = GenerateWords(generator, word_count);
+    SuggestionIndex suggestions({2, 4, 10});
+    for (size_t word_id = 0; word_id < words.size(); ++word_id) {
+        suggestions.SetDocumentCount(words[word_id], 1 + static_cast<int>(word_id % 5));
+    }
+
+    int mismatches = 0;
+    for (int i = 0; i < pattern_count; ++i) {
+        const string pattern = GenerateWord(generator);
+        vector<pair<string_view, int>> found;
+        for (const Suggestion& suggestion : suggestions.SuggestCorrections(pattern, words.size())) {
+            found.push_back({suggestion.word, suggestion.edits});
+        }
+        vector<pair<string_view, int>> expected;
+        for (const string& word : words) {
+            const int edits = ComputeDistance(Decode(pattern), Decode(word), true);
+            if (edits <= 2) {
+                expected.push_back({word, edits});
+            }
+        }
+        sort(found.begin(), found.end());
+        sort(expected.begin(), expected.end());
+        if (found != expected) {
+            cout << "corrections: "s << pattern << " finds "s << found.size()
+                 << " words instead of "s << expected.size() << endl;
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+int CheckQueries() {
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "пушистый белый кот"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "ухоженный пёс"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(3, "fluffy cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.EnableSuggestions();
+
+    const vector<pair<string, int>> cases = {
+        {"пушстый~"s, 1}, {"Пушистй~"s, 1}, {"пущистый~"s, 1}, {"пушстый~2"s, 1},
+        {"ухожнный~"s, 2}, {"пес~"s, 2}, {"flufy~"s, 3}, {"пушстй~"s, 0}, {"пушстй~2"s, 1},
+    };
+    int mismatches = 0;
+    for (const auto& [query, expected_id] : cases) {
+        const auto documents = search_server.FindTopDocuments(query);
+        const int found_id = documents.empty() ? 0 : documents.front().id;
+        if (found_id != expected_id || documents.size() > 1) {
+            cout << "query: "s << query << " finds "s << documents.size() << " documents, first "s << found_id
+                 << " instead of "s << expected_id << endl;
+            ++mismatches;
+        }
+    }
+
+    const vector<pair<string, string>> corrections = {
+        {"пушстый"s, "пушистый"s}, {"ПУШИСТЫИ"s, "пушистый"s}, {"ухожнный"s, "ухоженный"s},
+        {"уохженный"s, "ухоженный"s}, {"пес"s, "пёс"s}, {"flufy"s, "fluffy"s},
+    };
+    for (const auto& [word, expected] : corrections) {
+        const auto suggestions = search_server.SuggestCorrections(word);
+        if (suggestions.empty() || suggestions.front().word != expected) {
+            const string found = suggestions.empty() ? "nothing"s : string(suggestions.front().word);
+            cout << "correction: "s << word << " gives "s << found << " instead of "s << expected << endl;
+            ++mismatches;
+        }
+    }
+    const vector<pair<string, string>> completions = {
+        {"Пу"s, "пушистый"s}, {"пуш"s, "пушистый"s}, {"ухо"s, "ухоженный"s}, {"F"s, "fluffy"s}, {"Б"s, "белый"s},
+    };
+    for (const auto& [prefix, expected] : completions) {
+        const auto suggestions = search_server.SuggestCompletions(prefix);
+        if (suggestions.size() != 1 || suggestions.front().word != expected) {
+            cout << "completion: "s << prefix << " gives "s << suggestions.size() << " words instead of "s
+                 << expected << endl;
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int word_count = argc > 1 ? stoi(argv[1]) : 6000;
+    const int pattern_count = argc > 2 ? stoi(argv[2]) : 300;
+
+    const int mismatches = CheckDictionary(word_count, pattern_count) + CheckCorrections(word_count, pattern_count)
+        + CheckQueries();
+    cout << (mismatches == 0 ? "OK"s : "FAILED"s) << endl;
+    return mismatches == 0 ? 0 : 1;
+}
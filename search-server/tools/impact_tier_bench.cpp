@@ -0,0 +1,156 @@
+// Recall and latency of FindTopDocuments on the impact tier against the exhaustive
+// ranking of the full index, for several tier sizes and recall thresholds. Recall is
+// the share of the exhaustive top found by the tier search, over the queries with
+// a non-empty exhaustive top.
+//
+// Usage: impact_tier_bench <corpus> [tsv|jsonl] [query_log|-] [tier_sizes] [min_recalls] [stop_words]
+// Without a query log (or with -) the queries are 1 to 4 words of random documents.
+// Tier sizes and recall thresholds are comma separated, by default 16,64,256 and 1,0.6,0
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../corpus_loader.h"
+#include "../latency_stats.h"
+#include "../query_log.h"
+#include "../search_server.h"
+
+using namespace std;
+
+namespace {
+
+const size_t SAMPLED_QUERY_COUNT = 2000;
+
+template <typename Value>
+vector<Value> ParseList(const string& text) {
+    vector<Value> values;
+    istringstream input(text);
+    string item;
+    while (getline(input, item, ',')) {
+        istringstream item_input(item);
+        Value value;
+        item_input >> value;
+        values.push_back(value);
+    }
+    return values;
+}
+
+vector<string> SampleQueries(const SearchServer& search_server, const vector<int>& document_ids) {
+    mt19937 generator;
+    vector<string> queries;
+    //documents of stop words only give no query
+    for (size_t attempt = 0; !document_ids.empty() && attempt < 10 * SAMPLED_QUERY_COUNT
+                             && queries.size() < SAMPLED_QUERY_COUNT; ++attempt) {
+        const auto& word_frequencies = search_server.GetWordFrequencies(document_ids[generator() % document_ids.size()]);
+        if (word_frequencies.empty()) {
+            continue;
+        }
+        string query;
+        const int word_count = 1 + static_cast<int>(generator() % 4);
+        for (int i = 0; i < word_count; ++i) {
+            auto it = word_frequencies.begin();
+            advance(it, generator() % word_frequencies.size());
+            query += it->first;
+            query += ' ';
+        }
+        queries.push_back(move(query));
+    }
+    return queries;
+}
+
+struct RunResult {
+    vector<vector<Document>> results;
+    vector<chrono::microseconds> latencies;
+};
+
+RunResult RunQueries(const SearchServer& search_server, const vector<string>& queries, const SearchOptions& options) {
+    RunResult run;
+    for (const string& query : queries) {
+        const auto start = chrono::steady_clock::now();
+        run.results.push_back(search_server.FindTopDocuments(query, options));
+        run.latencies.push_back(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start));
+    }
+    return run;
+}
+
+size_t GetTierBytes(const SearchServer& search_server) {
+    for (const IndexPartStats& part : search_server.GetIndexStats().parts) {
+        if (part.name == "impact tier"s) {
+            return part.bytes;
+        }
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: impact_tier_bench <corpus> [tsv|jsonl] [query_log|-] [tier_sizes] [min_recalls] [stop_words]"s
+             << endl;
+        return 1;
+    }
+    CorpusLoadOptions load_options;
+    if (argc > 2 && argv[2] == "jsonl"s) {
+        load_options.format = CorpusFormat::JSONL;
+    }
+    const vector<int> tier_sizes = ParseList<int>(argc > 4 ? argv[4] : "16,64,256");
+    const vector<double> min_recalls = ParseList<double>(argc > 5 ? argv[5] : "1,0.6,0");
+    SearchServer search_server(argc > 6 ? string(argv[6]) : string());
+    const CorpusLoadResult load_result = LoadCorpus(search_server, argv[1], load_options);
+
+    vector<string> queries;
+    if (argc > 3 && argv[3] != "-"s) {
+        for (QueryLogRecord& record : ReadQueryLog(argv[3])) {
+            queries.push_back(move(record.query));
+        }
+    } else {
+        queries = SampleQueries(search_server, vector<int>(search_server.begin(), search_server.end()));
+    }
+    cout << "documents = "s << load_result.added_documents << ", queries = "s << queries.size() << endl;
+
+    RunResult exhaustive = RunQueries(search_server, queries, {});
+    cout << "exhaustive: "s << SummarizeLatencies(exhaustive.latencies) << endl;
+
+    for (const int tier_size : tier_sizes) {
+        search_server.EnableImpactTier({tier_size});
+        cout << "tier size = "s << tier_size << ", tier MB = "s << GetTierBytes(search_server) / double(1 << 20) << endl;
+        for (const double min_recall : min_recalls) {
+            SearchOptions options;
+            options.use_impact_tier = true;
+            options.min_tier_recall = min_recall;
+            const ImpactTierStats stats_before = search_server.GetImpactTierStats();
+            RunResult tier = RunQueries(search_server, queries, options);
+            const ImpactTierStats stats_after = search_server.GetImpactTierStats();
+
+            double recall_sum = 0.0;
+            size_t scored_queries = 0;
+            size_t complete_queries = 0;
+            for (size_t i = 0; i < queries.size(); ++i) {
+                const vector<Document>& expected = exhaustive.results[i];
+                if (expected.empty()) {
+                    continue;
+                }
+                const auto found = count_if(expected.begin(), expected.end(), [&](const Document& document) {
+                    return any_of(tier.results[i].begin(), tier.results[i].end(), [&](const Document& other) {
+                        return other.id == document.id;
+                    });
+                });
+                recall_sum += static_cast<double>(found) / expected.size();
+                ++scored_queries;
+                complete_queries += static_cast<size_t>(found) == expected.size();
+            }
+            const uint64_t fallbacks = stats_after.fallbacks - stats_before.fallbacks;
+            cout << "  min recall = "s << min_recall
+                 << ", recall = "s << (scored_queries == 0 ? 1.0 : recall_sum / scored_queries)
+                 << ", complete = "s << (scored_queries == 0 ? 1.0 : double(complete_queries) / scored_queries)
+                 << ", fallbacks = "s << double(fallbacks) / queries.size()
+                 << ", latency: "s << SummarizeLatencies(tier.latencies) << endl;
+        }
+    }
+}
@@ -0,0 +1,56 @@
+// Loads a corpus file into a SearchServer and prints the estimated memory of the
+// index parts next to the resident memory of the process. With remove_share, that
+// share of the documents is removed afterwards to show the space left behind.
+//
+// Usage: index_stats <file> [tsv|jsonl] [stop_words] [remove_share]
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "../corpus_loader.h"
+#include "../search_server.h"
+
+using namespace std;
+
+namespace {
+
+size_t GetResidentBytes() {
+    ifstream statm("/proc/self/statm"s);
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    statm >> total_pages >> resident_pages;
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: index_stats <file> [tsv|jsonl] [stop_words] [remove_share]"s << endl;
+        return 1;
+    }
+    CorpusLoadOptions options;
+    if (argc > 2 && argv[2] == "jsonl"s) {
+        options.format = CorpusFormat::JSONL;
+    }
+    SearchServer search_server(argc > 3 ? string(argv[3]) : string());
+    const CorpusLoadResult result = LoadCorpus(search_server, argv[1], options);
+    cout << "documents = "s << result.added_documents << ", rejected = "s << result.rejected_records
+         << ", file MB = "s << result.bytes / double(1 << 20) << endl;
+
+    if (argc > 4) {
+        const double remove_share = stod(argv[4]);
+        const vector<int> document_ids(search_server.begin(), search_server.end());
+        const size_t step = remove_share > 0.0 ? static_cast<size_t>(1.0 / remove_share) : 0;
+        for (size_t i = 0; step > 0 && i < document_ids.size(); i += step) {
+            search_server.RemoveDocument(document_ids[i]);
+        }
+    }
+
+    const IndexStats stats = search_server.GetIndexStats();
+    cout << stats;
+    cout << "resident MB = "s << GetResidentBytes() / double(1 << 20) << endl;
+}
@@ -0,0 +1,34 @@
+// Loads a corpus file into a SearchServer and reports the load throughput.
+//
+// Usage: load_corpus <file> [tsv|jsonl] [parser_threads] [stop_words]
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "../corpus_loader.h"
+#include "../search_server.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: load_corpus <file> [tsv|jsonl] [parser_threads] [stop_words]"s << endl;
+        return 1;
+    }
+    CorpusLoadOptions options;
+    if (argc > 2 && argv[2] == "jsonl"s) {
+        options.format = CorpusFormat::JSONL;
+    }
+    if (argc > 3) {
+        options.parser_threads = stoi(argv[3]);
+    }
+    SearchServer search_server(argc > 4 ? string(argv[4]) : string());
+
+    const auto start = chrono::steady_clock::now();
+    const CorpusLoadResult result = LoadCorpus(search_server, argv[1], options);
+    const auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "documents = "s << result.added_documents << ", rejected = "s << result.rejected_records
+         << ", MB/s = "s << result.bytes / elapsed / (1 << 20) << ", seconds = "s << elapsed << endl;
+}
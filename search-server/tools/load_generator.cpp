@@ -0,0 +1,120 @@
+// Closed-loop load on QueryFrontEnd over loopback: every client sends a query,
+// waits for the answer and sends the next one.
+//
+// Usage: load_generator [clients] [queries_per_client] [address]
+// Without an address the corpus from main.cpp is indexed and served in-process
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../latency_stats.h"
+#include "../query_front_end.h"
+#include "../query_generator.h"
+#include "../search_server.h"
+#include "../socket_io.h"
+
+using namespace std;
+
+namespace {
+
+const string DEFAULT_ADDRESS = "127.0.0.1:47321"s;
+
+bool ReadLine(int fd, string& buffer, string& line) {
+    size_t line_end;
+    while ((line_end = buffer.find('\n')) == string::npos) {
+        char chunk[4096];
+        const size_t received = ReadSome(fd, chunk, sizeof(chunk));
+        if (received == 0) {
+            return false;
+        }
+        buffer.append(chunk, received);
+    }
+    line = buffer.substr(0, line_end);
+    buffer.erase(0, line_end + 1);
+    return true;
+}
+
+vector<chrono::microseconds> RunClient(const string& address, const vector<string>& queries,
+                                       atomic<int>& failed_requests) {
+    vector<chrono::microseconds> latencies;
+    const int fd = ConnectSocket(address, SocketClock::now() + chrono::seconds(5));
+    if (fd < 0) {
+        failed_requests += static_cast<int>(queries.size());
+        return latencies;
+    }
+    string buffer;
+    string response;
+    for (const string& query : queries) {
+        const auto start = chrono::steady_clock::now();
+        const string request = query + '\n';
+        if (!WriteAll(fd, request.data(), request.size()) || !ReadLine(fd, buffer, response)) {
+            ++failed_requests;
+            break;
+        }
+        latencies.push_back(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start));
+    }
+    CloseSocket(fd);
+    return latencies;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int client_count = argc > 1 ? stoi(argv[1]) : 16;
+    const int queries_per_client = argc > 2 ? stoi(argv[2]) : 200;
+
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
+
+    SearchServer search_server(dictionary[0]);
+    unique_ptr<QueryFrontEnd> front_end;
+    thread front_end_thread;
+    const string address = argc > 3 ? argv[3] : DEFAULT_ADDRESS;
+    if (argc <= 3) {
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        front_end = make_unique<QueryFrontEnd>(search_server, address);
+        front_end_thread = thread([&front_end] { front_end->Serve(); });
+    }
+
+    vector<vector<string>> client_queries;
+    for (int i = 0; i < client_count; ++i) {
+        client_queries.push_back(GenerateQueries(generator, dictionary, queries_per_client, 70));
+    }
+
+    atomic<int> failed_requests = 0;
+    vector<vector<chrono::microseconds>> client_latencies(client_count);
+    const auto start = chrono::steady_clock::now();
+    {
+        vector<thread> clients;
+        for (int i = 0; i < client_count; ++i) {
+            clients.emplace_back([&, i] {
+                client_latencies[i] = RunClient(address, client_queries[i], failed_requests);
+            });
+        }
+        for (auto& client : clients) {
+            client.join();
+        }
+    }
+    const auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<chrono::microseconds> latencies;
+    for (const auto& part : client_latencies) {
+        latencies.insert(latencies.end(), part.begin(), part.end());
+    }
+    cout << "clients = "s << client_count << ", QPS = "s << latencies.size() / elapsed
+         << ", failed = "s << failed_requests << endl;
+    cout << SummarizeLatencies(latencies) << endl;
+
+    if (front_end) {
+        front_end->Stop();
+        front_end_thread.join();
+    }
+}
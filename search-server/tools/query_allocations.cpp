@@ -0,0 +1,171 @@
+// Counts the heap allocations of sequential FindTopDocuments calls once the query
+// arenas have warmed up. A query may allocate only the vector it returns; the tool
+// prints the worst query of every kind and fails if any query allocates more.
+//
+// Usage: query_allocations [document_count] [query_count]
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <execution>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../query_generator.h"
+#include "../search_server.h"
+
+using namespace std;
+
+namespace {
+
+atomic<uint64_t> allocation_count = 0;
+
+// All the replaceable forms allocate with malloc or aligned_alloc and free with free,
+// so that every new is paired with a matching delete and every allocation is counted
+void* CountedAllocate(size_t size, size_t alignment) {
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    size = size == 0 ? 1 : size;
+    //aligned_alloc wants the size to be a multiple of the alignment
+    void* memory = alignment <= alignof(max_align_t)
+        ? malloc(size) : aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if (memory == nullptr) {
+        throw bad_alloc();
+    }
+    return memory;
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+    return CountedAllocate(size, alignof(max_align_t));
+}
+
+void* operator new[](size_t size) {
+    return CountedAllocate(size, alignof(max_align_t));
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+    return CountedAllocate(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, align_val_t alignment) {
+    return CountedAllocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, align_val_t) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, align_val_t) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t, align_val_t) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, size_t, align_val_t) noexcept {
+    free(memory);
+}
+
+namespace {
+
+struct QueryKind {
+    string name;
+    SearchOptions options;
+    bool prepared = false;
+};
+
+// The most allocations a query of the kind made after the warm-up run
+template <typename Query, typename Search>
+uint64_t CountWorstQuery(const vector<Query>& queries, Search search) {
+    for (const Query& query : queries) {
+        search(query);
+    }
+    uint64_t worst = 0;
+    for (const Query& query : queries) {
+        const uint64_t before = allocation_count.load(memory_order_relaxed);
+        const vector<Document> result = search(query);
+        const uint64_t allocations = allocation_count.load(memory_order_relaxed) - before;
+        //the returned vector is the one allocation allowed
+        worst = max(worst, allocations - (result.capacity() > 0 ? 1 : 0));
+    }
+    return worst;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int document_count = argc > 1 ? stoi(argv[1]) : 10000;
+    const int query_count = argc > 2 ? stoi(argv[2]) : 1000;
+
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 2000, 10);
+    SearchServer search_server(dictionary[0] + " "s + dictionary[1]);
+    for (int i = 0; i < document_count; ++i) {
+        search_server.AddDocument(i, GenerateQuery(generator, dictionary, 70), DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    search_server.EnableImpactTier();
+
+    vector<string> queries = GenerateQueries(generator, dictionary, query_count, 7);
+    for (size_t i = 0; i < queries.size(); i += 4) {
+        //phrases, wildcards and fuzzy words go through the other parts of the parser
+        queries[i] += " \""s + dictionary[i % dictionary.size()] + " "s + dictionary[(i + 1) % dictionary.size()]
+                      + "\" "s + dictionary[(i + 2) % dictionary.size()].substr(0, 3) + "* "s
+                      + dictionary[(i + 3) % dictionary.size()] + "~"s;
+    }
+
+    vector<QueryKind> kinds(6);
+    kinds[0].name = "tf-idf"s;
+    kinds[1].name = "bm25"s;
+    kinds[1].options.ranking = RankingModel::BM25;
+    kinds[2].name = "all words"s;
+    kinds[2].options.mode = QueryMode::ALL;
+    kinds[3].name = "field weights"s;
+    kinds[3].options.field_weights = {{"title"s, 2.0}};
+    kinds[4].name = "impact tier"s;
+    kinds[4].options.use_impact_tier = true;
+    kinds[5].name = "prepared"s;
+    kinds[5].prepared = true;
+
+    bool passed = true;
+    for (const QueryKind& kind : kinds) {
+        uint64_t worst = 0;
+        if (kind.prepared) {
+            vector<SearchServer::PreparedQuery> prepared_queries;
+            for (const string& query : queries) {
+                prepared_queries.push_back(search_server.PrepareQuery(query, kind.options));
+            }
+            worst = CountWorstQuery(prepared_queries, [&](const SearchServer::PreparedQuery& prepared_query) {
+                return search_server.FindTopDocuments(prepared_query);
+            });
+        } else {
+            worst = CountWorstQuery(queries, [&](const string& query) {
+                return search_server.FindTopDocuments(execution::seq, query, kind.options);
+            });
+        }
+        cout << kind.name << ": "s << worst << " extra allocations at most"s << endl;
+        passed = passed && worst == 0;
+    }
+    cout << (passed ? "OK"s : "FAILED"s) << endl;
+    return passed ? 0 : 1;
+}
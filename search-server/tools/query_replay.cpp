@@ -0,0 +1,120 @@
+// Replays a query log captured by RequestQueue against a SearchServer loaded from
+// a corpus file, with several concurrent clients taking the records in log order.
+// At speed 0 a client sends its next query as soon as the previous one is answered.
+// Otherwise every query is sent at its recorded start divided by speed, and its latency
+// is counted from that moment, so a server falling behind shows in the percentiles.
+//
+// Usage: query_replay <log> <corpus> [tsv|jsonl] [clients] [speed] [stop_words]
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../corpus_loader.h"
+#include "../latency_stats.h"
+#include "../query_log.h"
+#include "../search_server.h"
+
+using namespace std;
+
+namespace {
+
+vector<Document> RunQuery(const SearchServer& search_server, const QueryLogRecord& record) {
+    switch (record.filter.kind) {
+    case QueryFilterKind::STATUS:
+        return search_server.FindTopDocuments(record.query, static_cast<DocumentStatus>(record.filter.value));
+    case QueryFilterKind::RATING_AT_LEAST:
+        return search_server.FindTopDocuments(record.query, RatingAtLeast{record.filter.value});
+    case QueryFilterKind::ANY_DOCUMENT:
+        return search_server.FindTopDocuments(record.query, AnyDocument{});
+    case QueryFilterKind::CUSTOM:
+        break;
+    }
+    return search_server.FindTopDocuments(record.query);
+}
+
+struct ClientResult {
+    vector<chrono::microseconds> latencies;
+    vector<chrono::microseconds> service_times;
+    int failed_requests = 0;
+    int changed_result_counts = 0;
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        cerr << "Usage: query_replay <log> <corpus> [tsv|jsonl] [clients] [speed] [stop_words]"s << endl;
+        return 1;
+    }
+    const vector<QueryLogRecord> records = ReadQueryLog(argv[1]);
+    CorpusLoadOptions load_options;
+    if (argc > 3 && argv[3] == "jsonl"s) {
+        load_options.format = CorpusFormat::JSONL;
+    }
+    const int client_count = argc > 4 ? stoi(argv[4]) : 8;
+    const double speed = argc > 5 ? stod(argv[5]) : 0.0;
+    SearchServer search_server(argc > 6 ? string(argv[6]) : string());
+    const CorpusLoadResult load_result = LoadCorpus(search_server, argv[2], load_options);
+    cout << "documents = "s << load_result.added_documents << ", records = "s << records.size() << endl;
+
+    atomic<size_t> next_record = 0;
+    vector<ClientResult> client_results(client_count);
+    const auto start = chrono::steady_clock::now();
+    {
+        vector<thread> clients;
+        for (int i = 0; i < client_count; ++i) {
+            clients.emplace_back([&, i] {
+                ClientResult& result = client_results[i];
+                for (size_t index = next_record++; index < records.size(); index = next_record++) {
+                    const QueryLogRecord& record = records[index];
+                    auto scheduled = chrono::steady_clock::now();
+                    if (speed > 0.0) {
+                        scheduled = start + chrono::duration_cast<chrono::steady_clock::duration>(record.start / speed);
+                        this_thread::sleep_until(scheduled);
+                    }
+                    const auto sent = chrono::steady_clock::now();
+                    try {
+                        const size_t result_count = RunQuery(search_server, record).size();
+                        result.changed_result_counts += result_count != record.result_count;
+                    } catch (const exception&) {
+                        ++result.failed_requests;
+                        continue;
+                    }
+                    const auto answered = chrono::steady_clock::now();
+                    result.latencies.push_back(chrono::duration_cast<chrono::microseconds>(answered - scheduled));
+                    result.service_times.push_back(chrono::duration_cast<chrono::microseconds>(answered - sent));
+                }
+            });
+        }
+        for (auto& client : clients) {
+            client.join();
+        }
+    }
+    const auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<chrono::microseconds> latencies;
+    vector<chrono::microseconds> service_times;
+    int failed_requests = 0;
+    int changed_result_counts = 0;
+    for (const ClientResult& result : client_results) {
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+        service_times.insert(service_times.end(), result.service_times.begin(), result.service_times.end());
+        failed_requests += result.failed_requests;
+        changed_result_counts += result.changed_result_counts;
+    }
+    vector<chrono::microseconds> recorded_latencies;
+    for (const QueryLogRecord& record : records) {
+        recorded_latencies.push_back(record.latency);
+    }
+
+    cout << "clients = "s << client_count << ", speed = "s << speed << ", QPS = "s << latencies.size() / elapsed
+         << ", failed = "s << failed_requests << ", changed result counts = "s << changed_result_counts << endl;
+    cout << "latency:  "s << SummarizeLatencies(latencies) << endl;
+    cout << "service:  "s << SummarizeLatencies(service_times) << endl;
+    cout << "recorded: "s << SummarizeLatencies(recorded_latencies) << endl;
+}